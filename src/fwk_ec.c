@@ -10,6 +10,7 @@
  */
 
 #include <linux/interrupt.h>
+#include <linux/kthread.h>
 #include <linux/module.h>
 #include <linux/of_platform.h>
 #include <linux/platform_device.h>
@@ -17,9 +18,39 @@
 #include <fwk_ec_proto.h>
 #include <linux/slab.h>
 #include <linux/suspend.h>
+#include <linux/timekeeping.h>
 
 #include "fwk_ec.h"
 
+/* Length of the window the event rate is measured over. */
+#define FWK_EC_IRQ_RATE_WINDOW_MS	100
+
+#ifdef CONFIG_PM_SLEEP
+static void fwk_ec_resume_work(struct kthread_work *work);
+static void fwk_ec_resume_event_work(struct kthread_work *work);
+#endif
+
+enum fwk_ec_core_stat {
+	FWK_EC_CORE_STAT_IRQS,
+	FWK_EC_CORE_STAT_EVENT_ERRORS,
+	FWK_EC_CORE_STAT_WAKE_EVENTS,
+	FWK_EC_CORE_STAT_POLLS,
+	FWK_EC_CORE_STAT_SUSPENDS,
+	FWK_EC_CORE_STAT_RESUMES,
+	FWK_EC_CORE_STAT_SLEEP_EVENT_ERRORS,
+	FWK_EC_CORE_STATS,
+};
+
+static const char * const fwk_ec_core_stat_names[FWK_EC_CORE_STATS] = {
+	[FWK_EC_CORE_STAT_IRQS] = "irqs",
+	[FWK_EC_CORE_STAT_EVENT_ERRORS] = "event_errors",
+	[FWK_EC_CORE_STAT_WAKE_EVENTS] = "wake_events",
+	[FWK_EC_CORE_STAT_POLLS] = "polls",
+	[FWK_EC_CORE_STAT_SUSPENDS] = "suspends",
+	[FWK_EC_CORE_STAT_RESUMES] = "resumes",
+	[FWK_EC_CORE_STAT_SLEEP_EVENT_ERRORS] = "sleep_event_errors",
+};
+
 static struct fwk_ec_platform ec_p = {
 	.ec_name = FWK_EC_DEV_NAME,
 	.cmd_offset = EC_CMD_PASSTHRU_OFFSET(FWK_EC_DEV_EC_INDEX),
@@ -42,6 +73,7 @@ static irqreturn_t fwk_ec_irq_handler(int irq, void *data)
 	struct fwk_ec_device *ec_dev = data;
 
 	ec_dev->last_event_time = fwk_ec_get_time_ns();
+	fwk_ec_stat_inc(&ec_dev->stats.core, FWK_EC_CORE_STAT_IRQS);
 
 	return IRQ_WAKE_THREAD;
 }
@@ -49,34 +81,216 @@ static irqreturn_t fwk_ec_irq_handler(int irq, void *data)
 /**
  * fwk_ec_handle_event() - process and forward pending events on EC
  * @ec_dev: Device with events to process.
+ * @has_more_events: Set to true if the EC reported more pending events.
+ * @may_wake: Whether the events may signal a wakeup. ACPI notifications
+ *            come with their own wakeup notification and don't.
  *
  * Call this function in a loop when the kernel is notified that the EC has
  * pending events.
  *
- * Return: true if more events are still pending and this function should be
- * called again.
+ * Return: the return value of fwk_ec_get_next_event(), i.e. the size of the
+ * event fetched, 0 if there was none or a negative error code.
  */
-static bool fwk_ec_handle_event(struct fwk_ec_device *ec_dev)
+static int fwk_ec_handle_event(struct fwk_ec_device *ec_dev,
+			       bool *has_more_events, bool may_wake)
 {
-	bool wake_event;
-	bool ec_has_more_events;
+	bool wake_event = false;
 	int ret;
 
-	ret = fwk_ec_get_next_event(ec_dev, &wake_event, &ec_has_more_events);
+	ret = fwk_ec_get_next_event(ec_dev, may_wake ? &wake_event : NULL,
+				    has_more_events);
 
 	/*
 	 * Signal only if wake host events or any interrupt if
 	 * fwk_ec_get_next_event() returned an error (default value for
 	 * wake_event is true)
 	 */
-	if (wake_event && device_may_wakeup(ec_dev->dev))
+	if (wake_event && device_may_wakeup(ec_dev->dev)) {
+		fwk_ec_stat_inc(&ec_dev->stats.core,
+				FWK_EC_CORE_STAT_WAKE_EVENTS);
 		pm_wakeup_event(ec_dev->dev, 0);
+	}
 
 	if (ret > 0)
-		blocking_notifier_call_chain(&ec_dev->event_notifier,
-					     0, ec_dev);
+		fwk_ec_notify_event(ec_dev, 0);
+	else if (ret < 0)
+		fwk_ec_stat_inc(&ec_dev->stats.core,
+				FWK_EC_CORE_STAT_EVENT_ERRORS);
+
+	return ret;
+}
+
+/*
+ * Account @events handled by the interrupt thread and tell whether the
+ * event rate went over the polling threshold. Called with poll->lock held,
+ * the poll work restarts the window when it unmasks the interrupt.
+ */
+static bool fwk_ec_irq_storm(struct fwk_ec_device *ec_dev, unsigned int events)
+{
+	struct fwk_ec_irq_poll *poll = &ec_dev->irq_poll;
+	ktime_t now = ktime_get();
+
+	lockdep_assert_held(&poll->lock);
+
+	if (!poll->threshold)
+		return false;
+
+	if (ktime_ms_delta(now, poll->window_start) >= FWK_EC_IRQ_RATE_WINDOW_MS) {
+		poll->window_start = now;
+		poll->window_events = 0;
+	}
+	poll->window_events += events;
+
+	return (u64)poll->window_events * MSEC_PER_SEC >
+	       (u64)poll->threshold * FWK_EC_IRQ_RATE_WINDOW_MS;
+}
+
+/*
+ * Mask the interrupt and hand event processing over to the poll work.
+ * Called from the interrupt thread, hence disable_irq_nosync(), with
+ * poll->lock held.
+ */
+static void fwk_ec_irq_poll_start(struct fwk_ec_device *ec_dev)
+{
+	struct fwk_ec_irq_poll *poll = &ec_dev->irq_poll;
+
+	lockdep_assert_held(&poll->lock);
+
+	if (!poll->active) {
+		poll->active = true;
+		poll->enter_count++;
+		disable_irq_nosync(ec_dev->irq);
+		hrtimer_start(&poll->timer, us_to_ktime(poll->interval_us),
+			      HRTIMER_MODE_REL);
+		dev_dbg(ec_dev->dev, "event storm, switching to polled mode\n");
+	}
+}
+
+/*
+ * Leave polled mode and unmask the interrupt. Once this returns, neither the
+ * timer nor the poll work are pending.
+ */
+static void fwk_ec_irq_poll_stop(struct fwk_ec_device *ec_dev)
+{
+	struct fwk_ec_irq_poll *poll = &ec_dev->irq_poll;
+
+	mutex_lock(&poll->lock);
+	if (poll->active) {
+		poll->active = false;
+		poll->exit_count++;
+		enable_irq(ec_dev->irq);
+	}
+	mutex_unlock(&poll->lock);
+
+	/* Only an active poll work re-arms the timer, so this sticks. */
+	hrtimer_cancel(&poll->timer);
+	kthread_cancel_work_sync(&poll->work);
+}
+
+static void fwk_ec_event_work(struct kthread_work *work)
+{
+	struct fwk_ec_device *ec_dev = container_of(work, struct fwk_ec_device,
+						    event_work);
+	ktime_t notify_time = READ_ONCE(ec_dev->last_event_time);
+	bool ec_has_more_events;
+	bool dispatched = false;
+
+	do {
+		if (fwk_ec_handle_event(ec_dev, &ec_has_more_events,
+					false) > 0 && !dispatched) {
+			fwk_ec_latency_record(&ec_dev->event_latency,
+					      fwk_ec_get_time_ns() - notify_time);
+			dispatched = true;
+		}
+	} while (ec_has_more_events);
+}
+
+/**
+ * fwk_ec_queue_event_work() - Drain pending EC events from the event worker.
+ * @ec_dev: Device with events to process.
+ *
+ * For transports notified of events in a context that must not wait on the
+ * EC, e.g. an ACPI notify handler. The caller should update
+ * ec_dev->last_event_time first, it is the reference of the notify to
+ * dispatch latency statistics.
+ */
+void fwk_ec_queue_event_work(struct fwk_ec_device *ec_dev)
+{
+	kthread_queue_work(ec_dev->event_worker, &ec_dev->event_work);
+}
+EXPORT_SYMBOL(fwk_ec_queue_event_work);
+
+static void fwk_ec_destroy_event_worker(void *data)
+{
+	struct fwk_ec_device *ec_dev = data;
+	struct fwk_ec_irq_poll *poll = &ec_dev->irq_poll;
+
+	/* The IRQ is already freed, there is no depth left to balance. */
+	mutex_lock(&poll->lock);
+	poll->active = false;
+	mutex_unlock(&poll->lock);
+
+	hrtimer_cancel(&poll->timer);
+	kthread_cancel_work_sync(&poll->work);
+	kthread_cancel_work_sync(&ec_dev->event_work);
+#ifdef CONFIG_PM_SLEEP
+	kthread_cancel_work_sync(&ec_dev->resume_work);
+	kthread_cancel_work_sync(&ec_dev->resume_event_work);
+#endif
+	kthread_destroy_worker(ec_dev->event_worker);
+	ec_dev->event_worker = NULL;
+}
+
+static enum hrtimer_restart fwk_ec_irq_poll_timer(struct hrtimer *timer)
+{
+	struct fwk_ec_device *ec_dev = container_of(timer, struct fwk_ec_device,
+						    irq_poll.timer);
+
+	kthread_queue_work(ec_dev->event_worker, &ec_dev->irq_poll.work);
+
+	return HRTIMER_NORESTART;
+}
+
+static void fwk_ec_irq_poll_work(struct kthread_work *work)
+{
+	struct fwk_ec_device *ec_dev = container_of(work, struct fwk_ec_device,
+						    irq_poll.work);
+	struct fwk_ec_irq_poll *poll = &ec_dev->irq_poll;
+	bool ec_has_more_events = false;
+	u32 budget = max_t(u32, poll->budget, 1);
+	u32 done;
 
-	return ec_has_more_events;
+	mutex_lock(&poll->lock);
+	if (!poll->active)
+		goto out;
+
+	fwk_ec_stat_inc(&ec_dev->stats.core, FWK_EC_CORE_STAT_POLLS);
+
+	/*
+	 * Not every EC sets EC_MKBP_HAS_MORE_EVENTS, so keep fetching until
+	 * the queue is reported empty or the budget is exhausted.
+	 */
+	for (done = 0; done < budget; done++) {
+		if (fwk_ec_handle_event(ec_dev, &ec_has_more_events,
+					true) <= 0 && !ec_has_more_events)
+			break;
+	}
+
+	if (done == budget) {
+		hrtimer_start(&poll->timer, us_to_ktime(poll->interval_us),
+			      HRTIMER_MODE_REL);
+		goto out;
+	}
+
+	/* Queue drained: go back to interrupt mode. */
+	poll->active = false;
+	poll->exit_count++;
+	poll->window_start = ktime_get();
+	poll->window_events = 0;
+	enable_irq(ec_dev->irq);
+	dev_dbg(ec_dev->dev, "event queue drained, back to interrupt mode\n");
+out:
+	mutex_unlock(&poll->lock);
 }
 
 /**
@@ -84,17 +298,32 @@ static bool fwk_ec_handle_event(struct fwk_ec_device *ec_dev)
  * @irq: IRQ id
  * @data: (ec_dev) Device with events to process.
  *
+ * When the event rate goes over the irq_poll threshold, the interrupt is
+ * masked and the EC is polled from the event worker until its queue drains.
+ *
  * Return: Interrupt handled.
  */
 irqreturn_t fwk_ec_irq_thread(int irq, void *data)
 {
 	struct fwk_ec_device *ec_dev = data;
+	struct fwk_ec_irq_poll *poll = &ec_dev->irq_poll;
 	bool ec_has_more_events;
+	unsigned int events = 0;
 
 	do {
-		ec_has_more_events = fwk_ec_handle_event(ec_dev);
+		/* Only the fetches which returned an event count. */
+		if (fwk_ec_handle_event(ec_dev, &ec_has_more_events,
+					true) > 0)
+			events++;
 	} while (ec_has_more_events);
 
+	if (irq > 0 && events) {
+		mutex_lock(&poll->lock);
+		if (fwk_ec_irq_storm(ec_dev, events))
+			fwk_ec_irq_poll_start(ec_dev);
+		mutex_unlock(&poll->lock);
+	}
+
 	return IRQ_HANDLED;
 }
 EXPORT_SYMBOL(fwk_ec_irq_thread);
@@ -155,13 +384,15 @@ static int fwk_ec_ready_event(struct notifier_block *nb,
 			       void *_notify)
 {
 	struct fwk_ec_device *ec_dev = container_of(nb, struct fwk_ec_device,
-						     notifier_ready);
-	u32 host_event = fwk_ec_get_host_event(ec_dev);
+						     notifier_ready.nb);
+	u64 host_event = fwk_ec_get_host_event64(ec_dev);
 
 	if (host_event & EC_HOST_EVENT_MASK(EC_HOST_EVENT_INTERFACE_READY)) {
 		mutex_lock(&ec_dev->lock);
 		fwk_ec_query_all(ec_dev);
 		mutex_unlock(&ec_dev->lock);
+		/* Restore the host events consumers asked for. */
+		fwk_ec_host_event_masks_sync(ec_dev);
 		return NOTIFY_OK;
 	}
 
@@ -181,9 +412,25 @@ int fwk_ec_register(struct fwk_ec_device *ec_dev)
 {
 	struct device *dev = ec_dev->dev;
 	int err = 0;
+	int i;
+
+	err = fwk_ec_stats_init(ec_dev);
+	if (err)
+		return err;
+
+	ec_dev->stats.core.name = "core";
+	ec_dev->stats.core.names = fwk_ec_core_stat_names;
+	ec_dev->stats.core.count = FWK_EC_CORE_STATS;
+	err = devm_fwk_ec_stats_group_init(dev, &ec_dev->stats.core);
+	if (err)
+		return err;
+	fwk_ec_stats_register(ec_dev, &ec_dev->stats.core);
 
 	BLOCKING_INIT_NOTIFIER_HEAD(&ec_dev->event_notifier);
 	BLOCKING_INIT_NOTIFIER_HEAD(&ec_dev->panic_notifier);
+	init_rwsem(&ec_dev->event_subscribers_rwsem);
+	for (i = 0; i < EC_MKBP_EVENT_COUNT; i++)
+		INIT_LIST_HEAD(&ec_dev->event_subscribers[i]);
 
 	ec_dev->max_request = sizeof(struct ec_params_hello);
 	ec_dev->max_response = sizeof(struct ec_response_get_protocol_info);
@@ -191,6 +438,22 @@ int fwk_ec_register(struct fwk_ec_device *ec_dev)
 	ec_dev->ec = NULL;
 	ec_dev->pd = NULL;
 	ec_dev->suspend_timeout_ms = EC_HOST_SLEEP_TIMEOUT_DEFAULT;
+	mutex_init(&ec_dev->sleep_history.lock);
+	mutex_init(&ec_dev->host_event_masks.lock);
+	spin_lock_init(&ec_dev->wake_stats.lock);
+
+	ec_dev->irq_poll.threshold = FWK_EC_IRQ_POLL_THRESHOLD;
+	ec_dev->irq_poll.budget = FWK_EC_IRQ_POLL_BUDGET;
+	ec_dev->irq_poll.interval_us = FWK_EC_IRQ_POLL_INTERVAL_US;
+	mutex_init(&ec_dev->irq_poll.lock);
+	hrtimer_init(&ec_dev->irq_poll.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ec_dev->irq_poll.timer.function = fwk_ec_irq_poll_timer;
+	kthread_init_work(&ec_dev->irq_poll.work, fwk_ec_irq_poll_work);
+	kthread_init_work(&ec_dev->event_work, fwk_ec_event_work);
+#ifdef CONFIG_PM_SLEEP
+	kthread_init_work(&ec_dev->resume_work, fwk_ec_resume_work);
+	kthread_init_work(&ec_dev->resume_event_work, fwk_ec_resume_event_work);
+#endif
 
 	ec_dev->din = devm_kzalloc(dev, ec_dev->din_size, GFP_KERNEL);
 	if (!ec_dev->din)
@@ -200,16 +463,49 @@ int fwk_ec_register(struct fwk_ec_device *ec_dev)
 	if (!ec_dev->dout)
 		return -ENOMEM;
 
+	ec_dev->event_ring.events = devm_kcalloc(dev, FWK_EC_EVENT_RING_SIZE,
+					sizeof(*ec_dev->event_ring.events),
+					GFP_KERNEL);
+	if (!ec_dev->event_ring.events)
+		return -ENOMEM;
+	spin_lock_init(&ec_dev->event_ring.lock);
+	ec_dev->event_ring.head = 1;
+
 	lockdep_register_key(&ec_dev->lockdep_key);
 	mutex_init(&ec_dev->lock);
 	lockdep_set_class(&ec_dev->lock, &ec_dev->lockdep_key);
 
+	spin_lock_init(&ec_dev->bus.lock);
+	ec_dev->bus.quantum_us = FWK_EC_BUS_QUANTUM_US;
+	for (i = 0; i < FWK_EC_BUS_TARGETS; i++)
+		INIT_LIST_HEAD(&ec_dev->bus.targets[i].waiters);
+
 	err = fwk_ec_query_all(ec_dev);
 	if (err) {
 		dev_err(dev, "Cannot identify the EC: error %d\n", err);
 		goto exit;
 	}
 
+	err = fwk_ec_host_event_masks_sync(ec_dev);
+	if (err)
+		dev_dbg(dev, "Cannot read host event masks: error %d\n", err);
+
+	ec_dev->event_worker = kthread_create_worker(0, "%s-event",
+						     dev_name(dev));
+	if (IS_ERR(ec_dev->event_worker)) {
+		err = PTR_ERR(ec_dev->event_worker);
+		ec_dev->event_worker = NULL;
+		goto exit;
+	}
+	/* Same priority as a threaded interrupt handler. */
+	sched_set_fifo(ec_dev->event_worker->task);
+
+	/* Registered first, so released after the IRQ is freed. */
+	err = devm_add_action_or_reset(dev, fwk_ec_destroy_event_worker,
+				       ec_dev);
+	if (err)
+		goto exit;
+
 	if (ec_dev->irq > 0) {
 		err = devm_request_threaded_irq(dev, ec_dev->irq,
 						fwk_ec_irq_handler,
@@ -272,14 +568,19 @@ int fwk_ec_register(struct fwk_ec_device *ec_dev)
 		dev_dbg(ec_dev->dev, "Error %d clearing sleep event to ec\n",
 			err);
 
-	if (ec_dev->mkbp_event_supported) {
+	if (ec_dev->mkbp_event_supported || ec_dev->host_event_memmap) {
 		/*
 		 * Register the notifier for EC_HOST_EVENT_INTERFACE_READY
 		 * event.
 		 */
-		ec_dev->notifier_ready.notifier_call = fwk_ec_ready_event;
-		err = blocking_notifier_chain_register(&ec_dev->event_notifier,
-						      &ec_dev->notifier_ready);
+		ec_dev->notifier_ready.nb.notifier_call = fwk_ec_ready_event;
+		ec_dev->notifier_ready.event_types =
+			BIT(EC_MKBP_EVENT_HOST_EVENT) |
+			BIT(EC_MKBP_EVENT_HOST_EVENT64);
+		ec_dev->notifier_ready.host_event_mask =
+			EC_HOST_EVENT_MASK(EC_HOST_EVENT_INTERFACE_READY);
+		err = fwk_ec_register_event_subscriber(ec_dev,
+						       &ec_dev->notifier_ready);
 		if (err)
 			goto exit;
 	}
@@ -313,6 +614,7 @@ EXPORT_SYMBOL(fwk_ec_register);
  */
 void fwk_ec_unregister(struct fwk_ec_device *ec_dev)
 {
+	kthread_cancel_work_sync(&ec_dev->event_work);
 	platform_device_unregister(ec_dev->pd);
 	platform_device_unregister(ec_dev->ec);
 	mutex_destroy(&ec_dev->lock);
@@ -321,16 +623,60 @@ void fwk_ec_unregister(struct fwk_ec_device *ec_dev)
 EXPORT_SYMBOL(fwk_ec_unregister);
 
 #ifdef CONFIG_PM_SLEEP
+/*
+ * Return the record of suspend/resume cycle @cycle, or NULL if it has been
+ * overwritten already. Called with the sleep history lock held.
+ */
+static struct fwk_ec_sleep_record *
+fwk_ec_sleep_record_get(struct fwk_ec_device *ec_dev, u64 cycle)
+{
+	struct fwk_ec_sleep_history *hist = &ec_dev->sleep_history;
+
+	if (!cycle || cycle > hist->count ||
+	    hist->count - cycle >= FWK_EC_SLEEP_HISTORY_SIZE)
+		return NULL;
+
+	return &hist->records[(cycle - 1) % FWK_EC_SLEEP_HISTORY_SIZE];
+}
+
 static void fwk_ec_send_suspend_event(struct fwk_ec_device *ec_dev)
 {
+	struct fwk_ec_sleep_history *hist = &ec_dev->sleep_history;
+	struct fwk_ec_sleep_record *rec;
+	ktime_t start;
 	int ret;
 	u8 sleep_event;
 
+	/* A resume event still waiting on the worker goes out first. */
+	kthread_flush_work(&ec_dev->resume_event_work);
+
 	sleep_event = (!IS_ENABLED(CONFIG_ACPI) || pm_suspend_via_firmware()) ?
 		      HOST_SLEEP_EVENT_S3_SUSPEND :
 		      HOST_SLEEP_EVENT_S0IX_SUSPEND;
 
+	ret = fwk_ec_host_event_masks_prepare_sleep(ec_dev, sleep_event);
+	if (ret < 0)
+		dev_dbg(ec_dev->dev, "Error %d programming the sleep wake mask\n",
+			ret);
+
+	start = ktime_get();
 	ret = fwk_ec_sleep_event(ec_dev, sleep_event);
+	fwk_ec_stat_inc(&ec_dev->stats.core, FWK_EC_CORE_STAT_SUSPENDS);
+	if (ret < 0)
+		fwk_ec_stat_inc(&ec_dev->stats.core,
+				FWK_EC_CORE_STAT_SLEEP_EVENT_ERRORS);
+
+	mutex_lock(&hist->lock);
+	hist->count++;
+	rec = fwk_ec_sleep_record_get(ec_dev, hist->count);
+	memset(rec, 0, sizeof(*rec));
+	/* Same clock as fwk_ec_get_time_ns(), sampled before the command. */
+	rec->start = ktime_to_ns(ktime_mono_to_any(start, TK_OFFS_BOOT));
+	rec->sleep_event = sleep_event;
+	rec->suspend_ret = ret;
+	rec->suspend_event_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	mutex_unlock(&hist->lock);
+
 	if (ret < 0)
 		dev_dbg(ec_dev->dev, "Error %d sending suspend event to ec\n",
 			ret);
@@ -354,6 +700,14 @@ EXPORT_SYMBOL(fwk_ec_suspend_prepare);
 static void fwk_ec_disable_irq(struct fwk_ec_device *ec_dev)
 {
 	struct device *dev = ec_dev->dev;
+	struct fwk_ec_sleep_history *hist = &ec_dev->sleep_history;
+	struct fwk_ec_sleep_record *rec;
+	ktime_t start = ktime_get();
+
+	/* Balance the interrupt depth before disabling it for suspend. */
+	kthread_flush_work(&ec_dev->resume_work);
+	fwk_ec_irq_poll_stop(ec_dev);
+
 	if (device_may_wakeup(dev))
 		ec_dev->wake_enabled = !enable_irq_wake(ec_dev->irq);
 	else
@@ -361,6 +715,12 @@ static void fwk_ec_disable_irq(struct fwk_ec_device *ec_dev)
 
 	disable_irq(ec_dev->irq);
 	ec_dev->suspended = true;
+
+	mutex_lock(&hist->lock);
+	rec = fwk_ec_sleep_record_get(ec_dev, hist->count);
+	if (rec)
+		rec->irq_disable_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	mutex_unlock(&hist->lock);
 }
 
 /**
@@ -394,22 +754,28 @@ int fwk_ec_suspend(struct fwk_ec_device *ec_dev)
 }
 EXPORT_SYMBOL(fwk_ec_suspend);
 
-static void fwk_ec_report_events_during_suspend(struct fwk_ec_device *ec_dev)
+static u32 fwk_ec_report_events_during_suspend(struct fwk_ec_device *ec_dev)
 {
 	bool wake_event;
+	u32 events = 0;
 
-	while (ec_dev->mkbp_event_supported &&
+	while ((ec_dev->mkbp_event_supported || ec_dev->host_event_memmap) &&
 	       fwk_ec_get_next_event(ec_dev, &wake_event, NULL) > 0) {
-		blocking_notifier_call_chain(&ec_dev->event_notifier,
-					     1, ec_dev);
+		fwk_ec_notify_event(ec_dev, 1);
+		events++;
 
 		if (wake_event && device_may_wakeup(ec_dev->dev))
 			pm_wakeup_event(ec_dev->dev, 0);
 	}
+
+	return events;
 }
 
 static void fwk_ec_send_resume_event(struct fwk_ec_device *ec_dev)
 {
+	struct fwk_ec_sleep_history *hist = &ec_dev->sleep_history;
+	struct fwk_ec_sleep_record *rec;
+	ktime_t start;
 	int ret;
 	u8 sleep_event;
 
@@ -417,7 +783,27 @@ static void fwk_ec_send_resume_event(struct fwk_ec_device *ec_dev)
 		      HOST_SLEEP_EVENT_S3_RESUME :
 		      HOST_SLEEP_EVENT_S0IX_RESUME;
 
+	start = ktime_get();
 	ret = fwk_ec_sleep_event(ec_dev, sleep_event);
+	fwk_ec_stat_inc(&ec_dev->stats.core, FWK_EC_CORE_STAT_RESUMES);
+	if (ret < 0)
+		fwk_ec_stat_inc(&ec_dev->stats.core,
+				FWK_EC_CORE_STAT_SLEEP_EVENT_ERRORS);
+
+	mutex_lock(&hist->lock);
+	rec = fwk_ec_sleep_record_get(ec_dev, hist->count);
+	if (rec) {
+		rec->resume_ret = ret;
+		rec->resume_event_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		/* last_resume_result is only updated by v1 resume events. */
+		if (ret >= 0 && ec_dev->host_sleep_v1) {
+			rec->sleep_transitions = ec_dev->last_resume_result &
+				EC_HOST_RESUME_SLEEP_TRANSITIONS_MASK;
+			rec->timeout = !!(ec_dev->last_resume_result &
+					  EC_HOST_RESUME_SLEEP_TIMEOUT);
+		}
+	}
+	mutex_unlock(&hist->lock);
 	if (ret < 0)
 		dev_dbg(ec_dev->dev, "Error %d sending resume event to ec\n",
 			ret);
@@ -431,23 +817,68 @@ static void fwk_ec_send_resume_event(struct fwk_ec_device *ec_dev)
  */
 void fwk_ec_resume_complete(struct fwk_ec_device *ec_dev)
 {
-	fwk_ec_send_resume_event(ec_dev);
+	/*
+	 * The worker runs its works in order: the events queued during
+	 * suspend go out before the resume event, without holding up the
+	 * resume sequence meanwhile.
+	 */
+	kthread_queue_work(ec_dev->event_worker, &ec_dev->resume_event_work);
 }
 EXPORT_SYMBOL(fwk_ec_resume_complete);
 
+static void fwk_ec_resume_work(struct kthread_work *work)
+{
+	struct fwk_ec_device *ec_dev = container_of(work, struct fwk_ec_device,
+						    resume_work);
+	struct fwk_ec_sleep_history *hist = &ec_dev->sleep_history;
+	struct fwk_ec_sleep_record *rec;
+	ktime_t start = ktime_get();
+	u32 events;
+
+	/*
+	 * Let the mfd devices know about events that occur during
+	 * suspend. This way the clients know what to do with them.
+	 */
+	events = fwk_ec_report_events_during_suspend(ec_dev);
+
+	mutex_lock(&hist->lock);
+	rec = fwk_ec_sleep_record_get(ec_dev, hist->replay_cycle);
+	if (rec) {
+		rec->replay_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		rec->replay_events = events;
+	}
+	mutex_unlock(&hist->lock);
+
+	/* Only now, so that new events can't overtake the queued ones. */
+	enable_irq(ec_dev->irq);
+}
+
+static void fwk_ec_resume_event_work(struct kthread_work *work)
+{
+	struct fwk_ec_device *ec_dev = container_of(work, struct fwk_ec_device,
+						    resume_event_work);
+
+	fwk_ec_send_resume_event(ec_dev);
+}
+
 static void fwk_ec_enable_irq(struct fwk_ec_device *ec_dev)
 {
 	ec_dev->suspended = false;
-	enable_irq(ec_dev->irq);
 
 	if (ec_dev->wake_enabled)
 		disable_irq_wake(ec_dev->irq);
 
+	mutex_lock(&ec_dev->sleep_history.lock);
+	ec_dev->sleep_history.replay_cycle = ec_dev->sleep_history.count;
+	mutex_unlock(&ec_dev->sleep_history.lock);
+
 	/*
-	 * Let the mfd devices know about events that occur during
-	 * suspend. This way the clients know what to do with them.
+	 * Replaying the events queued during suspend means talking to the EC
+	 * and running all the notifiers: do it from the event worker rather
+	 * than in the middle of the resume sequence. Events notified through
+	 * ACPI are drained by the same worker, after the replay.
 	 */
-	fwk_ec_report_events_during_suspend(ec_dev);
+	kthread_queue_work(ec_dev->event_worker, &ec_dev->resume_work);
 }
 
 /**
@@ -476,7 +907,7 @@ EXPORT_SYMBOL(fwk_ec_resume_early);
 int fwk_ec_resume(struct fwk_ec_device *ec_dev)
 {
 	fwk_ec_enable_irq(ec_dev);
-	fwk_ec_send_resume_event(ec_dev);
+	fwk_ec_resume_complete(ec_dev);
 	return 0;
 }
 EXPORT_SYMBOL(fwk_ec_resume);
@@ -23,5 +23,6 @@ int fwk_ec_resume_early(struct fwk_ec_device *ec_dev);
 void fwk_ec_resume_complete(struct fwk_ec_device *ec_dev);
 
 irqreturn_t fwk_ec_irq_thread(int irq, void *data);
+void fwk_ec_queue_event_work(struct fwk_ec_device *ec_dev);
 
 #endif /* __FWK_EC_H */
@@ -13,9 +13,13 @@
 #include <linux/init.h>
 #include <linux/device.h>
 #include <linux/fs.h>
+#include <linux/kref.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <linux/miscdevice.h>
 #include <linux/mod_devicetable.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/notifier.h>
 #include <fwk_ec_chardev.h>
 #include <fwk_ec_commands.h>
@@ -25,31 +29,155 @@
 #include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/uaccess.h>
+#include <linux/version.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+
+/* The io_uring command API moved to its own header in 6.7. */
+#if IS_ENABLED(CONFIG_IO_URING) && \
+	LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+#include <linux/io_uring/cmd.h>
+#define FWK_EC_CHARDEV_URING_CMD
+#endif
 
 #define DRV_NAME		"fwk-ec-chardev"
 
-/* Arbitrary bounded size for the event queue */
-#define FWK_MAX_EVENT_LEN	PAGE_SIZE
+/* Bounds of the number of slots of the event queue */
+#define FWK_EVENT_QUEUE_DEFAULT	64
+#define FWK_EVENT_QUEUE_MAX	4096
+
+/* Bounds of the number of records of the mmap()ed event ring */
+#define FWK_EVENT_RING_DEFAULT	256
+#define FWK_EVENT_RING_MAX	65536
+
+/* Refresh period of the mmap()ed shadow of the EC memory map */
+#define FWK_MEMMAP_REFRESH_MS	500
+
+/* cmd_readmem() can read all of the memory map but its last byte. */
+#define FWK_MEMMAP_SHADOW_SIZE	(EC_MEMMAP_SIZE - 1)
+
+enum chardev_stat {
+	CHARDEV_STAT_OPENS,
+	CHARDEV_STAT_XCMDS,
+	CHARDEV_STAT_XCMD_ERRORS,
+	CHARDEV_STAT_READMEMS,
+	CHARDEV_STAT_EVENTS_QUEUED,
+	CHARDEV_STAT_EVENTS_DROPPED,
+	CHARDEV_STAT_EVENTS_READ,
+	CHARDEV_STAT_EVENTS_COALESCED,
+	CHARDEV_STAT_MEMMAP_REFRESHES,
+	CHARDEV_STATS,
+};
+
+static const char * const chardev_stat_names[CHARDEV_STATS] = {
+	[CHARDEV_STAT_OPENS] = "opens",
+	[CHARDEV_STAT_XCMDS] = "xcmds",
+	[CHARDEV_STAT_XCMD_ERRORS] = "xcmd_errors",
+	[CHARDEV_STAT_READMEMS] = "readmems",
+	[CHARDEV_STAT_EVENTS_QUEUED] = "events_queued",
+	[CHARDEV_STAT_EVENTS_DROPPED] = "events_dropped",
+	[CHARDEV_STAT_EVENTS_READ] = "events_read",
+	[CHARDEV_STAT_EVENTS_COALESCED] = "events_coalesced",
+	[CHARDEV_STAT_MEMMAP_REFRESHES] = "memmap_refreshes",
+};
+
+/**
+ * struct chardev_memmap - Shadow of the EC memory map shared by mappings.
+ * @kref: Held by each mapping of the shadow, and by the device while it
+ *        refreshes the shadow.
+ * @shadow: The vmalloc_user() page mapped to userspace.
+ */
+struct chardev_memmap {
+	struct kref kref;
+	struct fwk_ec_memmap_shadow *shadow;
+};
 
+/*
+ * memmap is allocated on the first mmap() of the EC memory map shadow, all
+ * the files of the device then map the same page. memmap_work refreshes it
+ * until the last mapping is gone, and the device drops it then. memmap_lock
+ * protects memmap and serializes the refreshes.
+ */
 struct chardev_data {
 	struct fwk_ec_dev *ec_dev;
 	struct miscdevice misc;
+	struct fwk_ec_stats_group stats;
+	struct chardev_memmap *memmap;
+	struct mutex memmap_lock;
+	struct delayed_work memmap_work;
 };
 
+/*
+ * Queued events live in the event_slots entries of events, a circular
+ * buffer allocated up front: event_count of them starting at event_first.
+ * Batched and timestamped reads format them into read_buf, sized for a
+ * timestamped record per slot. The first read_staged queued events are the
+ * ones a read() is copying out and are only popped once the copy succeeded;
+ * the producer never coalesces into them. read_lock serializes such reads
+ * and resizing the queue.
+ *
+ * When ring is set, events are written to the mmap()ed ring rather than
+ * queued to events. ring_head and ring_dropped are the kernel copies of the
+ * shared header fields, userspace may scribble over the mapping.
+ *
+ * With FWK_EC_DEV_FLAG_SHARED_LOG, events are read from the device event
+ * ring at log_cursor instead of being queued. The first log_stashed entries
+ * of log_stash are the records to return next, already filtered: a lost
+ * events marker and the event read along with it, or a record a read()
+ * failed to copy. log_lost is the number of lost events already reported.
+ * log_lock protects them.
+ *
+ * xcmd_buf is the command buffer of FWK_EC_DEV_IOCXCMD_V2, reused from one
+ * call to the next and only grown, with room for xcmd_buf_size data bytes.
+ */
 struct chardev_priv {
+	struct chardev_data *data;
 	struct fwk_ec_dev *ec_dev;
-	struct notifier_block notifier;
+	struct fwk_ec_stats_group *stats;
+	struct fwk_ec_event_subscriber subscriber;
 	wait_queue_head_t wait_event;
 	unsigned long event_mask;
-	struct list_head events;
-	size_t event_len;
+	u64 host_event_mask;
+	u32 flags;
+	struct ec_event *events;
+	u32 event_slots;
+	u32 event_first;
+	u32 event_count;
+	u32 event_policy;
+	struct fwk_ec_event_queue_stats event_stats;
+	struct mutex read_lock;
+	u8 *read_buf;
+	u32 read_staged;
+	struct fwk_ec_ring_header *ring;
+	struct fwk_ec_ring_event *ring_data;
+	u32 ring_entries;
+	u64 ring_head;
+	u64 ring_dropped;
+	struct mutex log_lock;
+	struct fwk_ec_event_cursor log_cursor;
+	struct fwk_ec_event_record log_stash[2];
+	u32 log_stashed;
+	u64 log_lost;
+	struct mutex xcmd_lock;
+	struct fwk_ec_command *xcmd_buf;
+	u32 xcmd_buf_size;
 };
 
+/* Sized for the largest EC_CMD_GET_NEXT_EVENT v1 payload. */
 struct ec_event {
-	struct list_head node;
-	size_t size;
+	u64 seq;
+	ktime_t irq_time;
+	ktime_t fetch_time;
+	ktime_t queue_time;
+	u8 size;
 	u8 event_type;
-	u8 data[];
+	u8 data[sizeof(union ec_response_get_next_data_v1)];
+};
+
+enum chardev_queue_result {
+	CHARDEV_EVENT_QUEUED,
+	CHARDEV_EVENT_COALESCED,
+	CHARDEV_EVENT_DROPPED,
 };
 
 static int ec_get_version(struct fwk_ec_dev *ec, char *str, int maxlen)
@@ -90,69 +218,578 @@ exit:
 	return ret;
 }
 
+/* Called with priv->wait_event.lock held. */
+static bool fwk_ec_chardev_ring_push(struct chardev_priv *priv,
+				     struct fwk_ec_device *ec_dev)
+{
+	struct fwk_ec_ring_header *hdr = priv->ring;
+	struct fwk_ec_ring_event *rec;
+	u64 head = priv->ring_head;
+
+	if (head - smp_load_acquire(&hdr->tail) >= priv->ring_entries) {
+		WRITE_ONCE(hdr->dropped, ++priv->ring_dropped);
+		return false;
+	}
+
+	rec = &priv->ring_data[head & (priv->ring_entries - 1)];
+	rec->seq = ec_dev->event_seq;
+	rec->irq_time_ns = ec_dev->event_irq_time;
+	rec->fetch_time_ns = ec_dev->event_fetch_time;
+	rec->queue_time_ns = fwk_ec_get_time_ns();
+	rec->event_type = ec_dev->event_data.event_type;
+	rec->size = min_t(int, ec_dev->event_size, sizeof(rec->data));
+	memcpy(rec->data, &ec_dev->event_data.data, rec->size);
+
+	/* Publish the record before the new head. */
+	WRITE_ONCE(priv->ring_head, head + 1);
+	smp_store_release(&hdr->head, head + 1);
+
+	return true;
+}
+
+static bool fwk_ec_chardev_ring_empty(struct chardev_priv *priv)
+{
+	return READ_ONCE(priv->ring_head) == READ_ONCE(priv->ring->tail);
+}
+
+/* Called with priv->wait_event.lock held, for the queued event at @i. */
+static struct ec_event *fwk_ec_chardev_event(struct chardev_priv *priv,
+					     u32 i)
+{
+	return &priv->events[(priv->event_first + i) % priv->event_slots];
+}
+
+/* Called with priv->wait_event.lock held. */
+static void fwk_ec_chardev_pop_events(struct chardev_priv *priv, u32 count)
+{
+	priv->event_first = (priv->event_first + count) % priv->event_slots;
+	WRITE_ONCE(priv->event_count, priv->event_count - count);
+	priv->read_staged -= min(priv->read_staged, count);
+}
+
+static void fwk_ec_chardev_stamp_event(struct ec_event *event,
+				       struct fwk_ec_device *ec_dev)
+{
+	event->seq = ec_dev->event_seq;
+	event->irq_time = ec_dev->event_irq_time;
+	event->fetch_time = ec_dev->event_fetch_time;
+	event->queue_time = fwk_ec_get_time_ns();
+}
+
+/*
+ * Fold an event into the newest queued one of the same type. Pending event
+ * bitmaps are merged, state snapshots replaced by the newer one. Other
+ * events can't be coalesced without losing information.
+ *
+ * Called with priv->wait_event.lock held.
+ */
+static bool fwk_ec_chardev_coalesce(struct chardev_priv *priv,
+				    struct fwk_ec_device *ec_dev,
+				    const u8 *data, u8 size)
+{
+	u8 type = ec_dev->event_data.event_type;
+	struct ec_event *event;
+	bool merge;
+	u32 i;
+	int j;
+
+	switch (type) {
+	case EC_MKBP_EVENT_HOST_EVENT:
+	case EC_MKBP_EVENT_HOST_EVENT64:
+	case EC_MKBP_EVENT_CEC_EVENT:
+		merge = true;
+		break;
+	case EC_MKBP_EVENT_KEY_MATRIX:
+	case EC_MKBP_EVENT_SENSOR_FIFO:
+	case EC_MKBP_EVENT_BUTTON:
+	case EC_MKBP_EVENT_SWITCH:
+		merge = false;
+		break;
+	default:
+		return false;
+	}
+
+	/* Events staged for a read() may already be in userspace. */
+	for (i = priv->event_count; i-- > priv->read_staged; ) {
+		event = fwk_ec_chardev_event(priv, i);
+		if (event->event_type != type)
+			continue;
+
+		if (merge) {
+			for (j = 0; j < size; j++)
+				event->data[j] |= data[j];
+			event->size = max(event->size, size);
+		} else {
+			memcpy(event->data, data, size);
+			event->size = size;
+		}
+		fwk_ec_chardev_stamp_event(event, ec_dev);
+		return true;
+	}
+
+	return false;
+}
+
+/* Called with priv->wait_event.lock held. */
+static enum chardev_queue_result
+fwk_ec_chardev_queue_event(struct chardev_priv *priv,
+			   struct fwk_ec_device *ec_dev)
+{
+	const u8 *data = (const u8 *)&ec_dev->event_data.data;
+	u8 type = ec_dev->event_data.event_type;
+	struct ec_event *event;
+	u8 size;
+
+	size = clamp_t(int, ec_dev->event_size, 0, sizeof(event->data));
+
+	if (priv->event_count == priv->event_slots) {
+		switch (priv->event_policy) {
+		case FWK_EC_EVENT_QUEUE_DROP_OLDEST:
+			fwk_ec_chardev_pop_events(priv, 1);
+			priv->event_stats.dropped_oldest++;
+			break;
+		case FWK_EC_EVENT_QUEUE_COALESCE:
+			if (fwk_ec_chardev_coalesce(priv, ec_dev, data, size)) {
+				priv->event_stats.coalesced++;
+				return CHARDEV_EVENT_COALESCED;
+			}
+			fallthrough;
+		default:
+			priv->event_stats.dropped_newest++;
+			return CHARDEV_EVENT_DROPPED;
+		}
+	}
+
+	event = fwk_ec_chardev_event(priv, priv->event_count);
+	event->size = size;
+	event->event_type = type;
+	memcpy(event->data, data, size);
+	fwk_ec_chardev_stamp_event(event, ec_dev);
+	WRITE_ONCE(priv->event_count, priv->event_count + 1);
+	priv->event_stats.queued++;
+
+	return CHARDEV_EVENT_QUEUED;
+}
+
 static int fwk_ec_chardev_mkbp_event(struct notifier_block *nb,
 				      unsigned long queued_during_suspend,
 				      void *_notify)
 {
 	struct chardev_priv *priv = container_of(nb, struct chardev_priv,
-						 notifier);
+						 subscriber.nb);
 	struct fwk_ec_device *ec_dev = priv->ec_dev->ec_dev;
-	struct ec_event *event;
-	unsigned long event_bit = 1 << ec_dev->event_data.event_type;
-	int total_size = sizeof(*event) + ec_dev->event_size;
+	enum chardev_queue_result res;
 
-	if (!(event_bit & priv->event_mask) ||
-	    (priv->event_len + total_size) > FWK_MAX_EVENT_LEN)
-		return NOTIFY_DONE;
-
-	event = kzalloc(total_size, GFP_KERNEL);
-	if (!event)
-		return NOTIFY_DONE;
-
-	event->size = ec_dev->event_size;
-	event->event_type = ec_dev->event_data.event_type;
-	memcpy(event->data, &ec_dev->event_data.data, ec_dev->event_size);
+	/* Readers of the shared log only need a wake up. */
+	if (READ_ONCE(priv->flags) & FWK_EC_DEV_FLAG_SHARED_LOG) {
+		wake_up_interruptible(&priv->wait_event);
+		return NOTIFY_OK;
+	}
 
+	/*
+	 * Once set up, the ring stays until the file is released. Only the
+	 * event types in priv->event_mask are dispatched to us.
+	 */
 	spin_lock(&priv->wait_event.lock);
-	list_add_tail(&event->node, &priv->events);
-	priv->event_len += total_size;
-	wake_up_locked(&priv->wait_event);
+	if (priv->ring) {
+		if (fwk_ec_chardev_ring_push(priv, ec_dev))
+			res = CHARDEV_EVENT_QUEUED;
+		else
+			res = CHARDEV_EVENT_DROPPED;
+	} else {
+		res = fwk_ec_chardev_queue_event(priv, ec_dev);
+	}
+	if (res != CHARDEV_EVENT_DROPPED)
+		wake_up_locked(&priv->wait_event);
 	spin_unlock(&priv->wait_event.lock);
 
-	return NOTIFY_OK;
+	switch (res) {
+	case CHARDEV_EVENT_QUEUED:
+		fwk_ec_stat_inc(priv->stats, CHARDEV_STAT_EVENTS_QUEUED);
+		return NOTIFY_OK;
+	case CHARDEV_EVENT_COALESCED:
+		fwk_ec_stat_inc(priv->stats, CHARDEV_STAT_EVENTS_COALESCED);
+		return NOTIFY_OK;
+	default:
+		fwk_ec_stat_inc(priv->stats, CHARDEV_STAT_EVENTS_DROPPED);
+		return NOTIFY_DONE;
+	}
 }
 
-static struct ec_event *fwk_ec_chardev_fetch_event(struct chardev_priv *priv,
-						    bool fetch, bool block)
+static int fwk_ec_chardev_fetch_event(struct chardev_priv *priv,
+				      struct ec_event *event,
+				      bool fetch, bool block)
 {
-	struct ec_event *event;
-	int err;
+	int err = 0;
 
 	spin_lock(&priv->wait_event.lock);
-	if (!block && list_empty(&priv->events)) {
-		event = ERR_PTR(-EWOULDBLOCK);
+	if (!block && !priv->event_count) {
+		err = -EWOULDBLOCK;
 		goto out;
 	}
 
-	if (!fetch) {
-		event = NULL;
+	if (!fetch)
 		goto out;
-	}
 
 	err = wait_event_interruptible_locked(priv->wait_event,
-					      !list_empty(&priv->events));
-	if (err) {
-		event = ERR_PTR(err);
+					      priv->event_count);
+	if (err)
 		goto out;
-	}
 
-	event = list_first_entry(&priv->events, struct ec_event, node);
-	list_del(&event->node);
-	priv->event_len -= sizeof(*event) + event->size;
+	*event = *fwk_ec_chardev_event(priv, 0);
+	fwk_ec_chardev_pop_events(priv, 1);
 
 out:
 	spin_unlock(&priv->wait_event.lock);
-	return event;
+	return err;
+}
+
+/*
+ * Format an event the way read() returns it with FWK_EC_DEV_FLAG_BATCH_READ
+ * or FWK_EC_DEV_FLAG_TIMESTAMPS set in @flags.
+ *
+ * Return: the size of the formatted event, or 0 if it doesn't fit in @room
+ * bytes.
+ */
+static size_t fwk_ec_chardev_format_event(const struct ec_event *event,
+					  u8 *buf, size_t room, u32 flags)
+{
+	struct fwk_ec_event_record *rec;
+
+	if (!(flags & FWK_EC_DEV_FLAG_TIMESTAMPS)) {
+		/* Length and type bytes, then the payload. */
+		if (event->size + 2 > room)
+			return 0;
+		buf[0] = event->size + 1;
+		memcpy(buf + 1, &event->event_type, event->size + 1);
+		return event->size + 2;
+	}
+
+	if (sizeof(*rec) > room)
+		return 0;
+
+	rec = (struct fwk_ec_event_record *)buf;
+	memset(rec, 0, sizeof(*rec));
+	rec->seq = event->seq;
+	rec->irq_time_ns = event->irq_time;
+	rec->fetch_time_ns = event->fetch_time;
+	rec->queue_time_ns = event->queue_time;
+	rec->event_type = event->event_type;
+	rec->size = event->size;
+	memcpy(rec->data, event->data, event->size);
+
+	return sizeof(*rec);
+}
+
+/*
+ * Read queued events in the format @flags select, as many as fit in @length
+ * bytes with FWK_EC_DEV_FLAG_BATCH_READ or else one, waiting for the first
+ * one if @block. The events stay queued if the copy to @buffer fails.
+ */
+static ssize_t fwk_ec_chardev_read_events(struct chardev_priv *priv,
+					  char __user *buffer, size_t length,
+					  u32 flags, bool block)
+{
+	u32 max = flags & FWK_EC_DEV_FLAG_BATCH_READ ? U32_MAX : 1;
+	size_t size, len, count;
+	u32 n;
+	int err;
+
+retry:
+	/* Wait without read_lock held, so O_NONBLOCK readers never sleep. */
+	spin_lock(&priv->wait_event.lock);
+	if (!block && !priv->event_count)
+		err = -EWOULDBLOCK;
+	else
+		err = wait_event_interruptible_locked(priv->wait_event,
+						      priv->event_count);
+	spin_unlock(&priv->wait_event.lock);
+	if (err)
+		return err;
+
+	if (mutex_lock_interruptible(&priv->read_lock))
+		return -ERESTARTSYS;
+
+	spin_lock(&priv->wait_event.lock);
+	if (!priv->event_count) {
+		/* Another reader got there first. */
+		spin_unlock(&priv->wait_event.lock);
+		mutex_unlock(&priv->read_lock);
+		goto retry;
+	}
+
+	/* No event takes more room than its timestamped record. */
+	size = min_t(size_t, length, priv->event_slots *
+		     sizeof(struct fwk_ec_event_record));
+	count = 0;
+	n = 0;
+	while (n < min(max, priv->event_count)) {
+		len = fwk_ec_chardev_format_event(fwk_ec_chardev_event(priv, n),
+						  priv->read_buf + count,
+						  size - count, flags);
+		if (!len)
+			break;
+		count += len;
+		n++;
+	}
+	priv->read_staged = n;
+	spin_unlock(&priv->wait_event.lock);
+
+	if (!n)
+		err = -EMSGSIZE;
+	else if (copy_to_user(buffer, priv->read_buf, count))
+		err = -EFAULT;
+
+	spin_lock(&priv->wait_event.lock);
+	/* Staged events the producer dropped meanwhile are already gone. */
+	if (!err)
+		fwk_ec_chardev_pop_events(priv, priv->read_staged);
+	priv->read_staged = 0;
+	spin_unlock(&priv->wait_event.lock);
+	mutex_unlock(&priv->read_lock);
+
+	if (err)
+		return err;
+
+	fwk_ec_stat_add(priv->stats, CHARDEV_STAT_EVENTS_READ, n);
+	return count;
+}
+
+static bool fwk_ec_chardev_log_wanted(struct chardev_priv *priv,
+				      const struct fwk_ec_event *event)
+{
+	u8 type = event->data.event_type;
+
+	if (type >= BITS_PER_LONG || !(priv->event_mask & BIT(type)))
+		return false;
+
+	return fwk_ec_host_event_match(type, event->size, &event->data.data,
+				       priv->host_event_mask);
+}
+
+/*
+ * Without priv->log_lock held, as a wait condition, the answer may be stale:
+ * the reader then just looks at the log again.
+ */
+static bool fwk_ec_chardev_log_pending(struct chardev_priv *priv)
+{
+	return READ_ONCE(priv->log_stashed) ||
+	       fwk_ec_event_ring_pending(priv->ec_dev->ec_dev,
+					 &priv->log_cursor);
+}
+
+/* Called with priv->log_lock held, with room for @rec in the stash. */
+static void fwk_ec_chardev_log_stash(struct chardev_priv *priv,
+				     const struct fwk_ec_event_record *rec)
+{
+	priv->log_stash[priv->log_stashed] = *rec;
+	WRITE_ONCE(priv->log_stashed, priv->log_stashed + 1);
+}
+
+/*
+ * Move the shared log forward until the stash holds the next record for
+ * this file: a lost events marker if the cursor skipped some, else the next
+ * wanted event. Events the file doesn't want are consumed on the way, so
+ * they don't show up as pending.
+ *
+ * Called with priv->log_lock held.
+ *
+ * Return: true if a record is stashed, false if the log holds nothing new.
+ */
+static bool fwk_ec_chardev_log_fill(struct chardev_priv *priv)
+{
+	struct fwk_ec_device *ec_dev = priv->ec_dev->ec_dev;
+	struct fwk_ec_event_record rec;
+	struct fwk_ec_event event;
+	u64 lost;
+
+	while (!priv->log_stashed) {
+		if (!fwk_ec_event_ring_read(ec_dev, &priv->log_cursor, &event))
+			return false;
+
+		if (priv->log_cursor.lost != priv->log_lost) {
+			/* Report the gap first, the event comes next. */
+			lost = priv->log_cursor.lost - priv->log_lost;
+			priv->log_lost = priv->log_cursor.lost;
+
+			spin_lock(&priv->wait_event.lock);
+			priv->event_stats.dropped_oldest += lost;
+			spin_unlock(&priv->wait_event.lock);
+			fwk_ec_stat_add(priv->stats, CHARDEV_STAT_EVENTS_DROPPED,
+					lost);
+
+			memset(&rec, 0, sizeof(rec));
+			rec.event_type = FWK_EC_EVENT_LOST;
+			rec.size = sizeof(lost);
+			memcpy(rec.data, &lost, sizeof(lost));
+			fwk_ec_chardev_log_stash(priv, &rec);
+		}
+
+		if (!fwk_ec_chardev_log_wanted(priv, &event))
+			continue;
+
+		memset(&rec, 0, sizeof(rec));
+		rec.seq = event.seq;
+		rec.irq_time_ns = event.irq_time;
+		rec.fetch_time_ns = event.fetch_time;
+		rec.queue_time_ns = event.queue_time;
+		rec.event_type = event.data.event_type;
+		rec.size = clamp_t(int, event.size, 0, sizeof(rec.data));
+		memcpy(rec.data, &event.data.data, rec.size);
+		fwk_ec_chardev_log_stash(priv, &rec);
+	}
+
+	return true;
+}
+
+/*
+ * Take the next record for this file from the shared log.
+ *
+ * Called with priv->log_lock held.
+ *
+ * Return: true if @rec was filled in, false if the log holds nothing new.
+ */
+static bool fwk_ec_chardev_log_next(struct chardev_priv *priv,
+				    struct fwk_ec_event_record *rec)
+{
+	if (!fwk_ec_chardev_log_fill(priv))
+		return false;
+
+	*rec = priv->log_stash[0];
+	WRITE_ONCE(priv->log_stashed, priv->log_stashed - 1);
+	memmove(&priv->log_stash[0], &priv->log_stash[1],
+		priv->log_stashed * sizeof(*rec));
+	return true;
+}
+
+/*
+ * Give back the record fwk_ec_chardev_log_next() just returned, it comes
+ * next again. Called with priv->log_lock held.
+ */
+static void fwk_ec_chardev_log_unget(struct chardev_priv *priv,
+				     const struct fwk_ec_event_record *rec)
+{
+	memmove(&priv->log_stash[1], &priv->log_stash[0],
+		priv->log_stashed * sizeof(*rec));
+	priv->log_stash[0] = *rec;
+	WRITE_ONCE(priv->log_stashed, priv->log_stashed + 1);
+}
+
+/*
+ * Read records from the shared log, as many as fit in @length bytes with
+ * FWK_EC_DEV_FLAG_BATCH_READ or else one, waiting for the first one if
+ * @block.
+ */
+static ssize_t fwk_ec_chardev_read_log(struct chardev_priv *priv,
+				       char __user *buffer, size_t length,
+				       u32 flags, bool block)
+{
+	u32 max = flags & FWK_EC_DEV_FLAG_BATCH_READ ? U32_MAX : 1;
+	struct fwk_ec_event_record rec;
+	size_t count = 0;
+	u32 n = 0;
+	int err = 0;
+
+	if (length < sizeof(rec))
+		return -EMSGSIZE;
+
+	mutex_lock(&priv->log_lock);
+	while (n < max && count + sizeof(rec) <= length) {
+		if (!fwk_ec_chardev_log_next(priv, &rec)) {
+			if (n)
+				break;
+			if (!block) {
+				err = -EWOULDBLOCK;
+				break;
+			}
+
+			mutex_unlock(&priv->log_lock);
+			err = wait_event_interruptible(priv->wait_event,
+					fwk_ec_chardev_log_pending(priv));
+			mutex_lock(&priv->log_lock);
+			if (err)
+				break;
+			continue;
+		}
+
+		if (copy_to_user(buffer + count, &rec, sizeof(rec))) {
+			/* Don't lose the record, nor a lost events marker. */
+			fwk_ec_chardev_log_unget(priv, &rec);
+			err = -EFAULT;
+			break;
+		}
+		count += sizeof(rec);
+		n++;
+	}
+	mutex_unlock(&priv->log_lock);
+
+	fwk_ec_stat_add(priv->stats, CHARDEV_STAT_EVENTS_READ, n);
+
+	return count ? count : err;
+}
+
+static void fwk_ec_chardev_memmap_release(struct kref *kref)
+{
+	struct chardev_memmap *memmap = container_of(kref, struct chardev_memmap,
+						     kref);
+
+	vfree(memmap->shadow);
+	kfree(memmap);
+}
+
+static void fwk_ec_chardev_memmap_refresh(struct chardev_data *data)
+{
+	struct fwk_ec_device *ec_dev = data->ec_dev->ec_dev;
+	struct fwk_ec_memmap_shadow *shadow = data->memmap->shadow;
+	u8 buf[FWK_MEMMAP_SHADOW_SIZE];
+	int ret;
+
+	lockdep_assert_held(&data->memmap_lock);
+
+	/* Keep the odd sequence window short, read the EC first. */
+	ret = ec_dev->cmd_readmem(ec_dev, 0, sizeof(buf), buf);
+	fwk_ec_stat_inc(&data->stats, CHARDEV_STAT_MEMMAP_REFRESHES);
+
+	WRITE_ONCE(shadow->seq, shadow->seq + 1);
+	smp_wmb();
+	if (ret > 0)
+		memcpy(shadow->data, buf, ret);
+	WRITE_ONCE(shadow->error, min(ret, 0));
+	WRITE_ONCE(shadow->refresh_time_ns, fwk_ec_get_time_ns());
+	smp_store_release(&shadow->seq, shadow->seq + 1);
+}
+
+/*
+ * Runs on the freezable workqueue, so the EC isn't polled while the system
+ * is suspended.
+ */
+static void fwk_ec_chardev_memmap_work(struct work_struct *work)
+{
+	struct chardev_data *data = container_of(to_delayed_work(work),
+						 struct chardev_data,
+						 memmap_work);
+	struct chardev_memmap *memmap;
+
+	mutex_lock(&data->memmap_lock);
+	memmap = data->memmap;
+	if (!memmap)
+		goto unlock;
+
+	/*
+	 * Mappings are only added with the lock held while the device holds
+	 * its reference, or copied from an existing one.
+	 */
+	if (kref_read(&memmap->kref) == 1) {
+		data->memmap = NULL;
+		kref_put(&memmap->kref, fwk_ec_chardev_memmap_release);
+		goto unlock;
+	}
+
+	fwk_ec_chardev_memmap_refresh(data);
+	queue_delayed_work(system_freezable_wq, &data->memmap_work,
+			   msecs_to_jiffies(FWK_MEMMAP_REFRESH_MS));
+unlock:
+	mutex_unlock(&data->memmap_lock);
 }
 
 /*
@@ -161,6 +798,8 @@ out:
 static int fwk_ec_chardev_open(struct inode *inode, struct file *filp)
 {
 	struct miscdevice *mdev = filp->private_data;
+	struct chardev_data *data = container_of(mdev, struct chardev_data,
+						 misc);
 	struct fwk_ec_dev *ec_dev = dev_get_drvdata(mdev->parent);
 	struct chardev_priv *priv;
 	int ret;
@@ -169,17 +808,41 @@ static int fwk_ec_chardev_open(struct inode *inode, struct file *filp)
 	if (!priv)
 		return -ENOMEM;
 
+	priv->events = kvcalloc(FWK_EVENT_QUEUE_DEFAULT,
+				sizeof(*priv->events), GFP_KERNEL);
+	if (!priv->events) {
+		kfree(priv);
+		return -ENOMEM;
+	}
+	priv->read_buf = kvmalloc_array(FWK_EVENT_QUEUE_DEFAULT,
+					sizeof(struct fwk_ec_event_record),
+					GFP_KERNEL);
+	if (!priv->read_buf) {
+		kvfree(priv->events);
+		kfree(priv);
+		return -ENOMEM;
+	}
+	priv->event_slots = FWK_EVENT_QUEUE_DEFAULT;
+	priv->event_policy = FWK_EC_EVENT_QUEUE_DROP_NEWEST;
+
+	fwk_ec_stat_inc(&data->stats, CHARDEV_STAT_OPENS);
+	priv->data = data;
 	priv->ec_dev = ec_dev;
+	priv->stats = &data->stats;
 	filp->private_data = priv;
-	INIT_LIST_HEAD(&priv->events);
 	init_waitqueue_head(&priv->wait_event);
+	mutex_init(&priv->read_lock);
+	mutex_init(&priv->log_lock);
+	mutex_init(&priv->xcmd_lock);
 	nonseekable_open(inode, filp);
 
-	priv->notifier.notifier_call = fwk_ec_chardev_mkbp_event;
-	ret = blocking_notifier_chain_register(&ec_dev->ec_dev->event_notifier,
-					       &priv->notifier);
+	priv->subscriber.nb.notifier_call = fwk_ec_chardev_mkbp_event;
+	ret = fwk_ec_register_event_subscriber(ec_dev->ec_dev,
+					       &priv->subscriber);
 	if (ret) {
 		dev_err(ec_dev->dev, "failed to register event notifier\n");
+		kvfree(priv->read_buf);
+		kvfree(priv->events);
 		kfree(priv);
 	}
 
@@ -189,10 +852,25 @@ static int fwk_ec_chardev_open(struct inode *inode, struct file *filp)
 static __poll_t fwk_ec_chardev_poll(struct file *filp, poll_table *wait)
 {
 	struct chardev_priv *priv = filp->private_data;
+	bool pending;
 
 	poll_wait(filp, &priv->wait_event, wait);
 
-	if (list_empty(&priv->events))
+	if (priv->ring) {
+		if (fwk_ec_chardev_ring_empty(priv))
+			return 0;
+		return EPOLLIN | EPOLLRDNORM;
+	}
+
+	if (READ_ONCE(priv->flags) & FWK_EC_DEV_FLAG_SHARED_LOG) {
+		mutex_lock(&priv->log_lock);
+		pending = fwk_ec_chardev_log_fill(priv);
+		mutex_unlock(&priv->log_lock);
+	} else {
+		pending = READ_ONCE(priv->event_count);
+	}
+
+	if (!pending)
 		return 0;
 
 	return EPOLLIN | EPOLLRDNORM;
@@ -206,15 +884,39 @@ static ssize_t fwk_ec_chardev_read(struct file *filp, char __user *buffer,
 	struct chardev_priv *priv = filp->private_data;
 	struct fwk_ec_dev *ec_dev = priv->ec_dev;
 	size_t count;
+	u32 flags;
 	int ret;
 
+	/* Events are consumed straight from the mapping in ring mode. */
+	if (priv->ring)
+		return -EINVAL;
+
+	flags = READ_ONCE(priv->flags);
+	if (priv->event_mask && (flags & FWK_EC_DEV_FLAG_SHARED_LOG)) {
+		if (!length)
+			return 0;
+		ret = fwk_ec_chardev_read_log(priv, buffer, length, flags,
+					      !(filp->f_flags & O_NONBLOCK));
+		if (ret > 0)
+			*offset = ret;
+		return ret;
+	}
+
+	if (priv->event_mask && length && flags) {
+		ret = fwk_ec_chardev_read_events(priv, buffer, length, flags,
+						 !(filp->f_flags & O_NONBLOCK));
+		if (ret > 0)
+			*offset = ret;
+		return ret;
+	}
+
 	if (priv->event_mask) { /* queued MKBP event */
-		struct ec_event *event;
+		struct ec_event event;
 
-		event = fwk_ec_chardev_fetch_event(priv, length != 0,
-						!(filp->f_flags & O_NONBLOCK));
-		if (IS_ERR(event))
-			return PTR_ERR(event);
+		ret = fwk_ec_chardev_fetch_event(priv, &event, length != 0,
+						 !(filp->f_flags & O_NONBLOCK));
+		if (ret)
+			return ret;
 		/*
 		 * length == 0 is special - no IO is done but we check
 		 * for error conditions.
@@ -223,9 +925,9 @@ static ssize_t fwk_ec_chardev_read(struct file *filp, char __user *buffer,
 			return 0;
 
 		/* The event is 1 byte of type plus the payload */
-		count = min(length, event->size + 1);
-		ret = copy_to_user(buffer, &event->event_type, count);
-		kfree(event);
+		count = min_t(size_t, length, event.size + 1);
+		ret = copy_to_user(buffer, &event.event_type, count);
+		fwk_ec_stat_inc(priv->stats, CHARDEV_STAT_EVENTS_READ);
 		if (ret) /* the copy failed */
 			return -EFAULT;
 		*offset = count;
@@ -255,15 +957,13 @@ static int fwk_ec_chardev_release(struct inode *inode, struct file *filp)
 {
 	struct chardev_priv *priv = filp->private_data;
 	struct fwk_ec_dev *ec_dev = priv->ec_dev;
-	struct ec_event *event, *e;
 
-	blocking_notifier_chain_unregister(&ec_dev->ec_dev->event_notifier,
-					   &priv->notifier);
+	fwk_ec_unregister_event_subscriber(ec_dev->ec_dev, &priv->subscriber);
 
-	list_for_each_entry_safe(event, e, &priv->events, node) {
-		list_del(&event->node);
-		kfree(event);
-	}
+	kvfree(priv->events);
+	kvfree(priv->read_buf);
+	vfree(priv->ring);
+	kvfree(priv->xcmd_buf);
 	kfree(priv);
 
 	return 0;
@@ -272,7 +972,9 @@ static int fwk_ec_chardev_release(struct inode *inode, struct file *filp)
 /*
  * Ioctls
  */
-static long fwk_ec_chardev_ioctl_xcmd(struct fwk_ec_dev *ec, void __user *arg)
+static long fwk_ec_chardev_ioctl_xcmd(struct fwk_ec_dev *ec,
+				      struct fwk_ec_stats_group *stats,
+				      void __user *arg)
 {
 	struct fwk_ec_command *s_cmd;
 	struct fwk_ec_command u_cmd;
@@ -302,10 +1004,13 @@ static long fwk_ec_chardev_ioctl_xcmd(struct fwk_ec_dev *ec, void __user *arg)
 	}
 
 	s_cmd->command += ec->cmd_offset;
-	ret = fwk_ec_cmd_xfer(ec->ec_dev, s_cmd);
+	fwk_ec_stat_inc(stats, CHARDEV_STAT_XCMDS);
+	ret = fwk_ec_cmd_xfer_class(ec->ec_dev, s_cmd, FWK_EC_BUS_CLASS_USER);
 	/* Only copy data to userland if data was received. */
-	if (ret < 0)
+	if (ret < 0) {
+		fwk_ec_stat_inc(stats, CHARDEV_STAT_XCMD_ERRORS);
 		goto exit;
+	}
 
 	if (copy_to_user(arg, s_cmd, sizeof(*s_cmd) + s_cmd->insize))
 		ret = -EFAULT;
@@ -314,7 +1019,176 @@ exit:
 	return ret;
 }
 
+/* Called with priv->xcmd_lock held. */
+static struct fwk_ec_command *
+fwk_ec_chardev_xcmd_buf(struct chardev_priv *priv, u32 size)
+{
+	struct fwk_ec_command *msg;
+
+	if (priv->xcmd_buf && size <= priv->xcmd_buf_size)
+		return priv->xcmd_buf;
+
+	msg = kvmalloc(sizeof(*msg) + size, GFP_KERNEL);
+	if (!msg)
+		return NULL;
+
+	kvfree(priv->xcmd_buf);
+	priv->xcmd_buf = msg;
+	priv->xcmd_buf_size = size;
+
+	return msg;
+}
+
+static long fwk_ec_chardev_ioctl_xcmd_v2(struct chardev_priv *priv,
+					 void __user *arg)
+{
+	struct fwk_ec_xcmd_v2 __user *u_cmd = arg;
+	struct fwk_ec_dev *ec = priv->ec_dev;
+	struct fwk_ec_command *msg;
+	struct fwk_ec_xcmd_v2 cmd;
+	long ret;
+
+	if (copy_from_user(&cmd, u_cmd, sizeof(cmd)))
+		return -EFAULT;
+
+	if (cmd.flags || cmd.reserved ||
+	    cmd.outsize > EC_MAX_MSG_BYTES || cmd.insize > EC_MAX_MSG_BYTES)
+		return -EINVAL;
+
+	mutex_lock(&priv->xcmd_lock);
+	msg = fwk_ec_chardev_xcmd_buf(priv, max(cmd.outsize, cmd.insize));
+	if (!msg) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+
+	msg->version = cmd.version;
+	msg->command = cmd.command + ec->cmd_offset;
+	msg->outsize = cmd.outsize;
+	msg->insize = cmd.insize;
+	if (copy_from_user(msg->data, u64_to_user_ptr(cmd.out), cmd.outsize)) {
+		ret = -EFAULT;
+		goto unlock;
+	}
+
+	fwk_ec_stat_inc(priv->stats, CHARDEV_STAT_XCMDS);
+	ret = fwk_ec_cmd_xfer_class(ec->ec_dev, msg, FWK_EC_BUS_CLASS_USER);
+	if (ret < 0) {
+		fwk_ec_stat_inc(priv->stats, CHARDEV_STAT_XCMD_ERRORS);
+		goto unlock;
+	}
+
+	if (copy_to_user(u64_to_user_ptr(cmd.in), msg->data, ret) ||
+	    put_user(msg->result, &u_cmd->result) ||
+	    put_user(ret, &u_cmd->in_len))
+		ret = -EFAULT;
+unlock:
+	mutex_unlock(&priv->xcmd_lock);
+	return ret;
+}
+
+static long fwk_ec_chardev_ioctl_xcmd_batch(struct fwk_ec_dev *ec,
+					    struct fwk_ec_stats_group *stats,
+					    void __user *arg)
+{
+	struct fwk_ec_xcmd_entry __user *u_entries;
+	struct fwk_ec_command **msgs = NULL;
+	struct fwk_ec_xcmd_entry *entries;
+	struct fwk_ec_xcmd_batch batch;
+	size_t size, total = 0;
+	int *rets = NULL;
+	unsigned int i;
+	long ret = 0;
+
+	if (copy_from_user(&batch, arg, sizeof(batch)))
+		return -EFAULT;
+
+	if (batch.flags || !batch.count ||
+	    batch.count > FWK_EC_XCMD_BATCH_MAX)
+		return -EINVAL;
+
+	u_entries = u64_to_user_ptr(batch.entries);
+	/* batch.count is bounded, the size can't overflow. */
+	entries = memdup_user(u_entries, array_size(batch.count,
+						    sizeof(*entries)));
+	if (IS_ERR(entries))
+		return PTR_ERR(entries);
+
+	msgs = kcalloc(batch.count, sizeof(*msgs), GFP_KERNEL);
+	rets = kcalloc(batch.count, sizeof(*rets), GFP_KERNEL);
+	if (!msgs || !rets) {
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	for (i = 0; i < batch.count; i++) {
+		if (entries[i].outsize > EC_MAX_MSG_BYTES ||
+		    entries[i].insize > EC_MAX_MSG_BYTES) {
+			ret = -EINVAL;
+			goto exit;
+		}
+
+		size = max(entries[i].outsize, entries[i].insize);
+		total += size;
+		if (total > FWK_EC_XCMD_BATCH_MAX_BYTES) {
+			ret = -E2BIG;
+			goto exit;
+		}
+
+		msgs[i] = kzalloc(sizeof(*msgs[i]) + size, GFP_KERNEL);
+		if (!msgs[i]) {
+			ret = -ENOMEM;
+			goto exit;
+		}
+
+		if (copy_from_user(msgs[i]->data,
+				   u64_to_user_ptr(entries[i].data),
+				   entries[i].outsize)) {
+			ret = -EFAULT;
+			goto exit;
+		}
+
+		msgs[i]->version = entries[i].version;
+		msgs[i]->command = entries[i].command + ec->cmd_offset;
+		msgs[i]->outsize = entries[i].outsize;
+		msgs[i]->insize = entries[i].insize;
+	}
+
+	fwk_ec_stat_add(stats, CHARDEV_STAT_XCMDS, batch.count);
+	fwk_ec_cmd_xfer_batch(ec->ec_dev, msgs, rets, batch.count,
+			      FWK_EC_BUS_CLASS_USER);
+
+	for (i = 0; i < batch.count; i++) {
+		entries[i].result = msgs[i]->result;
+		entries[i].ret = rets[i];
+		if (rets[i] < 0) {
+			fwk_ec_stat_inc(stats, CHARDEV_STAT_XCMD_ERRORS);
+			continue;
+		}
+
+		/* Only copy data to userland if data was received. */
+		if (rets[i] &&
+		    copy_to_user(u64_to_user_ptr(entries[i].data),
+				 msgs[i]->data,
+				 min_t(u32, rets[i], msgs[i]->insize)))
+			ret = -EFAULT;
+	}
+
+	if (copy_to_user(u_entries, entries, batch.count * sizeof(*entries)))
+		ret = -EFAULT;
+exit:
+	if (msgs) {
+		for (i = 0; i < batch.count; i++)
+			kfree(msgs[i]);
+	}
+	kfree(msgs);
+	kfree(rets);
+	kfree(entries);
+	return ret;
+}
+
 static long fwk_ec_chardev_ioctl_readmem(struct fwk_ec_dev *ec,
+					   struct fwk_ec_stats_group *stats,
 					   void __user *arg)
 {
 	struct fwk_ec_device *ec_dev = ec->ec_dev;
@@ -331,6 +1205,8 @@ static long fwk_ec_chardev_ioctl_readmem(struct fwk_ec_dev *ec,
 	if (s_mem.bytes > sizeof(s_mem.buffer))
 		return -EINVAL;
 
+	fwk_ec_stat_inc(stats, CHARDEV_STAT_READMEMS);
+
 	num = ec_dev->cmd_readmem(ec_dev, s_mem.offset, s_mem.bytes,
 				  s_mem.buffer);
 	if (num <= 0)
@@ -342,6 +1218,163 @@ static long fwk_ec_chardev_ioctl_readmem(struct fwk_ec_dev *ec,
 	return num;
 }
 
+static long fwk_ec_chardev_ioctl_event_ring(struct chardev_priv *priv,
+					     void __user *arg)
+{
+	struct fwk_ec_event_ring_setup setup;
+	struct fwk_ec_ring_header *hdr;
+	size_t size;
+	long ret = 0;
+
+	if (copy_from_user(&setup, arg, sizeof(setup)))
+		return -EFAULT;
+
+	if (setup.flags)
+		return -EINVAL;
+
+	if (!setup.entries)
+		setup.entries = FWK_EVENT_RING_DEFAULT;
+	if (!is_power_of_2(setup.entries) ||
+	    setup.entries > FWK_EVENT_RING_MAX)
+		return -EINVAL;
+
+	size = PAGE_ALIGN(PAGE_SIZE +
+			  setup.entries * sizeof(struct fwk_ec_ring_event));
+	hdr = vmalloc_user(size);
+	if (!hdr)
+		return -ENOMEM;
+
+	hdr->version = FWK_EC_EVENT_RING_VERSION;
+	hdr->entries = setup.entries;
+	hdr->entry_size = sizeof(struct fwk_ec_ring_event);
+	hdr->data_offset = PAGE_SIZE;
+
+	spin_lock(&priv->wait_event.lock);
+	if (priv->ring || priv->event_count ||
+	    (priv->flags & FWK_EC_DEV_FLAG_SHARED_LOG)) {
+		ret = -EBUSY;
+	} else {
+		priv->ring_data = (void *)hdr + PAGE_SIZE;
+		priv->ring_entries = setup.entries;
+		priv->ring = hdr;
+	}
+	spin_unlock(&priv->wait_event.lock);
+
+	if (ret) {
+		vfree(hdr);
+		return ret;
+	}
+
+	setup.mmap_size = size;
+	if (copy_to_user(arg, &setup, sizeof(setup)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long fwk_ec_chardev_ioctl_event_queue(struct chardev_priv *priv,
+					      void __user *arg)
+{
+	struct fwk_ec_event_queue_config config;
+	struct ec_event *events, *old;
+	u8 *read_buf, *old_buf;
+	u32 i, skip;
+
+	if (copy_from_user(&config, arg, sizeof(config)))
+		return -EFAULT;
+
+	if (config.policy > FWK_EC_EVENT_QUEUE_COALESCE)
+		return -EINVAL;
+
+	if (!config.slots)
+		config.slots = FWK_EVENT_QUEUE_DEFAULT;
+	if (config.slots > FWK_EVENT_QUEUE_MAX)
+		return -EINVAL;
+
+	events = kvcalloc(config.slots, sizeof(*events), GFP_KERNEL);
+	read_buf = kvmalloc_array(config.slots,
+				  sizeof(struct fwk_ec_event_record),
+				  GFP_KERNEL);
+	if (!events || !read_buf) {
+		kvfree(events);
+		kvfree(read_buf);
+		return -ENOMEM;
+	}
+
+	/* Wait for a read() copying out of the current buffer. */
+	mutex_lock(&priv->read_lock);
+	spin_lock(&priv->wait_event.lock);
+	/* Keep the newest of the queued events which fit. */
+	skip = priv->event_count - min(priv->event_count, config.slots);
+	for (i = skip; i < priv->event_count; i++)
+		events[i - skip] = *fwk_ec_chardev_event(priv, i);
+	priv->event_stats.dropped_oldest += skip;
+
+	old = priv->events;
+	priv->events = events;
+	WRITE_ONCE(priv->event_slots, config.slots);
+	priv->event_first = 0;
+	WRITE_ONCE(priv->event_count, priv->event_count - skip);
+	priv->event_policy = config.policy;
+	spin_unlock(&priv->wait_event.lock);
+	old_buf = priv->read_buf;
+	priv->read_buf = read_buf;
+	mutex_unlock(&priv->read_lock);
+
+	if (skip)
+		fwk_ec_stat_add(priv->stats, CHARDEV_STAT_EVENTS_DROPPED, skip);
+	kvfree(old);
+	kvfree(old_buf);
+	return 0;
+}
+
+static long fwk_ec_chardev_ioctl_event_stats(struct chardev_priv *priv,
+					      void __user *arg)
+{
+	struct fwk_ec_event_queue_stats stats;
+
+	spin_lock(&priv->wait_event.lock);
+	stats = priv->event_stats;
+	stats.pending = priv->event_count;
+	stats.slots = priv->event_slots;
+	spin_unlock(&priv->wait_event.lock);
+
+	if (copy_to_user(arg, &stats, sizeof(stats)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long fwk_ec_chardev_ioctl_flags(struct chardev_priv *priv,
+				       unsigned long arg)
+{
+	long ret = 0;
+
+	if (arg & ~FWK_EC_DEV_FLAGS)
+		return -EINVAL;
+
+	mutex_lock(&priv->log_lock);
+	spin_lock(&priv->wait_event.lock);
+	if ((arg & ~priv->flags & FWK_EC_DEV_FLAG_SHARED_LOG) &&
+	    (priv->ring || priv->event_count)) {
+		/* Queued events would be stranded while reading the log. */
+		ret = -EBUSY;
+	} else {
+		/* Start reading the log from its end. */
+		if ((arg & ~priv->flags) & FWK_EC_DEV_FLAG_SHARED_LOG) {
+			fwk_ec_event_cursor_init(priv->ec_dev->ec_dev,
+						 &priv->log_cursor);
+			priv->log_stashed = 0;
+			priv->log_lost = 0;
+		}
+		WRITE_ONCE(priv->flags, arg);
+	}
+	spin_unlock(&priv->wait_event.lock);
+	mutex_unlock(&priv->log_lock);
+
+	return ret;
+}
+
 static long fwk_ec_chardev_ioctl(struct file *filp, unsigned int cmd,
 				   unsigned long arg)
 {
@@ -353,23 +1386,170 @@ static long fwk_ec_chardev_ioctl(struct file *filp, unsigned int cmd,
 
 	switch (cmd) {
 	case FWK_EC_DEV_IOCXCMD:
-		return fwk_ec_chardev_ioctl_xcmd(ec, (void __user *)arg);
+		return fwk_ec_chardev_ioctl_xcmd(ec, priv->stats,
+						 (void __user *)arg);
+	case FWK_EC_DEV_IOCXCMD_V2:
+		return fwk_ec_chardev_ioctl_xcmd_v2(priv, (void __user *)arg);
+	case FWK_EC_DEV_IOCXCMD_BATCH:
+		return fwk_ec_chardev_ioctl_xcmd_batch(ec, priv->stats,
+						       (void __user *)arg);
 	case FWK_EC_DEV_IOCRDMEM:
-		return fwk_ec_chardev_ioctl_readmem(ec, (void __user *)arg);
+		return fwk_ec_chardev_ioctl_readmem(ec, priv->stats,
+						    (void __user *)arg);
 	case FWK_EC_DEV_IOCEVENTMASK:
 		priv->event_mask = arg;
+		fwk_ec_update_event_subscriber(ec->ec_dev, &priv->subscriber,
+					       arg, priv->host_event_mask);
+		return 0;
+	case FWK_EC_DEV_IOCHOSTEVENTMASK:
+		if (get_user(priv->host_event_mask, (u64 __user *)arg))
+			return -EFAULT;
+		fwk_ec_update_event_subscriber(ec->ec_dev, &priv->subscriber,
+					       priv->event_mask,
+					       priv->host_event_mask);
 		return 0;
+	case FWK_EC_DEV_IOCEVENTRING:
+		return fwk_ec_chardev_ioctl_event_ring(priv,
+						       (void __user *)arg);
+	case FWK_EC_DEV_IOCEVENTQUEUE:
+		return fwk_ec_chardev_ioctl_event_queue(priv,
+							(void __user *)arg);
+	case FWK_EC_DEV_IOCEVENTSTATS:
+		return fwk_ec_chardev_ioctl_event_stats(priv,
+							(void __user *)arg);
+	case FWK_EC_DEV_IOCFLAGS:
+		return fwk_ec_chardev_ioctl_flags(priv, arg);
 	}
 
 	return -ENOTTY;
 }
 
+#ifdef FWK_EC_CHARDEV_URING_CMD
+static int fwk_ec_chardev_uring_cmd(struct io_uring_cmd *ioucmd,
+				    unsigned int issue_flags)
+{
+	struct chardev_priv *priv = ioucmd->file->private_data;
+	const struct fwk_ec_uring_cmd *cmd = io_uring_sqe_cmd(ioucmd->sqe);
+	void __user *arg = u64_to_user_ptr(READ_ONCE(cmd->arg));
+	struct fwk_ec_dev *ec = priv->ec_dev;
+
+	/*
+	 * There is no asynchronous command path down to the transport, and
+	 * sending a command sleeps: have io_uring issue it again from one of
+	 * its workers, where it completes inline.
+	 */
+	if (issue_flags & IO_URING_F_NONBLOCK)
+		return -EAGAIN;
+
+	switch (ioucmd->cmd_op) {
+	case FWK_EC_DEV_IOCXCMD:
+		return fwk_ec_chardev_ioctl_xcmd(ec, priv->stats, arg);
+	case FWK_EC_DEV_IOCXCMD_V2:
+		return fwk_ec_chardev_ioctl_xcmd_v2(priv, arg);
+	case FWK_EC_DEV_IOCRDMEM:
+		return fwk_ec_chardev_ioctl_readmem(ec, priv->stats, arg);
+	}
+
+	return -ENOTTY;
+}
+#endif
+
+static void fwk_ec_chardev_memmap_vm_open(struct vm_area_struct *vma)
+{
+	struct chardev_memmap *memmap = vma->vm_private_data;
+
+	kref_get(&memmap->kref);
+}
+
+static void fwk_ec_chardev_memmap_vm_close(struct vm_area_struct *vma)
+{
+	struct chardev_memmap *memmap = vma->vm_private_data;
+
+	kref_put(&memmap->kref, fwk_ec_chardev_memmap_release);
+}
+
+static const struct vm_operations_struct fwk_ec_chardev_memmap_vm_ops = {
+	.open = fwk_ec_chardev_memmap_vm_open,
+	.close = fwk_ec_chardev_memmap_vm_close,
+};
+
+static int fwk_ec_chardev_mmap_memmap(struct chardev_data *data,
+				      struct vm_area_struct *vma)
+{
+	struct fwk_ec_device *ec_dev = data->ec_dev->ec_dev;
+	struct chardev_memmap *memmap;
+	int ret = 0;
+
+	/* Not every platform supports direct reads */
+	if (!ec_dev->cmd_readmem)
+		return -ENODEV;
+
+	if (vma->vm_end - vma->vm_start != PAGE_SIZE)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	mutex_lock(&data->memmap_lock);
+	memmap = data->memmap;
+	if (!memmap) {
+		memmap = kzalloc(sizeof(*memmap), GFP_KERNEL);
+		if (!memmap) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
+		memmap->shadow = vmalloc_user(PAGE_SIZE);
+		if (!memmap->shadow) {
+			kfree(memmap);
+			ret = -ENOMEM;
+			goto unlock;
+		}
+		kref_init(&memmap->kref);
+		memmap->shadow->version = FWK_EC_MEMMAP_SHADOW_VERSION;
+		memmap->shadow->size = FWK_MEMMAP_SHADOW_SIZE;
+		data->memmap = memmap;
+		/* Readers get a valid page from the start. */
+		fwk_ec_chardev_memmap_refresh(data);
+		queue_delayed_work(system_freezable_wq, &data->memmap_work,
+				   msecs_to_jiffies(FWK_MEMMAP_REFRESH_MS));
+	}
+	ret = remap_vmalloc_range(vma, memmap->shadow, 0);
+	if (ret)
+		goto unlock;
+
+	vm_flags_clear(vma, VM_MAYWRITE);
+	vma->vm_private_data = memmap;
+	vma->vm_ops = &fwk_ec_chardev_memmap_vm_ops;
+	fwk_ec_chardev_memmap_vm_open(vma);
+unlock:
+	mutex_unlock(&data->memmap_lock);
+
+	return ret;
+}
+
+static int fwk_ec_chardev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct chardev_priv *priv = filp->private_data;
+
+	if (vma->vm_pgoff == FWK_EC_MEMMAP_MMAP_OFFSET >> PAGE_SHIFT)
+		return fwk_ec_chardev_mmap_memmap(priv->data, vma);
+
+	if (!priv->ring)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, priv->ring, vma->vm_pgoff);
+}
+
 static const struct file_operations chardev_fops = {
 	.open		= fwk_ec_chardev_open,
 	.poll		= fwk_ec_chardev_poll,
 	.read		= fwk_ec_chardev_read,
 	.release	= fwk_ec_chardev_release,
+	.mmap		= fwk_ec_chardev_mmap,
 	.unlocked_ioctl	= fwk_ec_chardev_ioctl,
+#ifdef FWK_EC_CHARDEV_URING_CMD
+	.uring_cmd	= fwk_ec_chardev_uring_cmd,
+#endif
 #ifdef CONFIG_COMPAT
 	.compat_ioctl	= fwk_ec_chardev_ioctl,
 #endif
@@ -380,13 +1560,26 @@ static int fwk_ec_chardev_probe(struct platform_device *pdev)
 	struct fwk_ec_dev *ec_dev = dev_get_drvdata(pdev->dev.parent);
 	struct fwk_ec_platform *ec_platform = dev_get_platdata(ec_dev->dev);
 	struct chardev_data *data;
+	int ret;
 
 	/* Create a char device: we want to create it anew */
 	data = devm_kzalloc(&pdev->dev, sizeof(*data), GFP_KERNEL);
 	if (!data)
 		return -ENOMEM;
 
+	data->stats.name = devm_kasprintf(&pdev->dev, GFP_KERNEL, "chardev.%s",
+					  ec_platform->ec_name);
+	if (!data->stats.name)
+		return -ENOMEM;
+	data->stats.names = chardev_stat_names;
+	data->stats.count = CHARDEV_STATS;
+	ret = devm_fwk_ec_stats_group_init(&pdev->dev, &data->stats);
+	if (ret)
+		return ret;
+
 	data->ec_dev = ec_dev;
+	mutex_init(&data->memmap_lock);
+	INIT_DELAYED_WORK(&data->memmap_work, fwk_ec_chardev_memmap_work);
 	data->misc.minor = MISC_DYNAMIC_MINOR;
 	data->misc.fops = &chardev_fops;
 	data->misc.name = ec_platform->ec_name;
@@ -394,14 +1587,30 @@ static int fwk_ec_chardev_probe(struct platform_device *pdev)
 
 	dev_set_drvdata(&pdev->dev, data);
 
-	return misc_register(&data->misc);
+	ret = misc_register(&data->misc);
+	if (ret)
+		return ret;
+
+	fwk_ec_stats_register(ec_dev->ec_dev, &data->stats);
+
+	return 0;
 }
 
 static void fwk_ec_chardev_remove(struct platform_device *pdev)
 {
 	struct chardev_data *data = dev_get_drvdata(&pdev->dev);
 
+	fwk_ec_stats_unregister(data->ec_dev->ec_dev, &data->stats);
 	misc_deregister(&data->misc);
+
+	/* Existing mappings keep their reference on the shadow. */
+	cancel_delayed_work_sync(&data->memmap_work);
+	mutex_lock(&data->memmap_lock);
+	if (data->memmap) {
+		kref_put(&data->memmap->kref, fwk_ec_chardev_memmap_release);
+		data->memmap = NULL;
+	}
+	mutex_unlock(&data->memmap_lock);
 }
 
 static const struct platform_device_id fwk_ec_chardev_id[] = {
@@ -30,9 +30,327 @@ struct fwk_ec_readmem {
 	uint8_t buffer[EC_MEMMAP_SIZE];
 };
 
+/* Layout version of the mmap()ed event ring. */
+#define FWK_EC_EVENT_RING_VERSION	1
+
+/**
+ * struct fwk_ec_event_ring_setup - Switch a file to the mmap()ed event ring.
+ * @entries: Number of event records, a power of 2 up to 65536. Zero picks
+ *           the default of 256.
+ * @flags: Must be zero.
+ * @mmap_size: Set to the length to mmap(), at offset 0.
+ */
+struct fwk_ec_event_ring_setup {
+	__u32 entries;
+	__u32 flags;
+	__u64 mmap_size;
+};
+
+/**
+ * struct fwk_ec_ring_header - First page of the mmap()ed event ring.
+ * @version: FWK_EC_EVENT_RING_VERSION.
+ * @entries: Number of records, a power of 2.
+ * @entry_size: Size of a record, sizeof(struct fwk_ec_ring_event) or more.
+ * @data_offset: Offset of the first record from the start of the mapping.
+ * @dropped: Number of events dropped because the ring was full.
+ * @reserved0: Zero.
+ * @head: Index of the next record the kernel writes. Only updated by the
+ *        kernel, after the record is written (store-release): load it with
+ *        acquire semantics before reading the records.
+ * @reserved1: Zero.
+ * @tail: Index of the next record userspace reads. Only updated by
+ *        userspace, once done with the records (store-release).
+ *
+ * Record i lives at @data_offset + (i & (@entries - 1)) * @entry_size.
+ * Records between @tail and @head are valid. Indices only ever grow. @head
+ * and @tail sit in separate cache lines.
+ */
+struct fwk_ec_ring_header {
+	__u32 version;
+	__u32 entries;
+	__u32 entry_size;
+	__u32 data_offset;
+	__u64 dropped;
+	__u8 reserved0[40];
+	__u64 head;
+	__u8 reserved1[56];
+	__u64 tail;
+};
+
+/**
+ * struct fwk_ec_ring_event - Event record of the mmap()ed event ring.
+ * @irq_time_ns: CLOCK_BOOTTIME time the EC signaled the event.
+ * @queue_time_ns: CLOCK_BOOTTIME time the record was written.
+ * @event_type: EC_MKBP_EVENT_* type of the event.
+ * @size: Number of valid bytes in @data.
+ * @reserved: Zero.
+ * @data: Event payload, see union ec_response_get_next_data_v1.
+ * @seq: Per-device sequence number of the event, as in
+ *       struct fwk_ec_event_record.
+ * @fetch_time_ns: CLOCK_BOOTTIME time the event was retrieved from the EC.
+ *
+ * @seq and @fetch_time_ns come after the original fields so that the
+ * records of older readers, which step by @entry_size, keep their layout.
+ */
+struct fwk_ec_ring_event {
+	__u64 irq_time_ns;
+	__u64 queue_time_ns;
+	__u8 event_type;
+	__u8 size;
+	__u8 reserved[6];
+	__u8 data[16];
+	__u64 seq;
+	__u64 fetch_time_ns;
+};
+
+/* Bounds of a FWK_EC_DEV_IOCXCMD_BATCH batch. */
+#define FWK_EC_XCMD_BATCH_MAX		32
+#define FWK_EC_XCMD_BATCH_MAX_BYTES	(256 * 1024)
+
+/**
+ * struct fwk_ec_xcmd_entry - Command of a FWK_EC_DEV_IOCXCMD_BATCH batch.
+ * @version: Command version number (often 0).
+ * @command: Command to send (EC_CMD_...).
+ * @outsize: Outgoing length in bytes.
+ * @insize: Max number of bytes to accept from the EC.
+ * @result: Set to the EC's response to the command.
+ * @ret: Set to the number of bytes received, or to a negative error code
+ *       if the command could not be sent.
+ * @data: Pointer to a buffer of max(@outsize, @insize) bytes, holding the
+ *        request, overwritten by the response.
+ */
+struct fwk_ec_xcmd_entry {
+	__u32 version;
+	__u32 command;
+	__u32 outsize;
+	__u32 insize;
+	__u32 result;
+	__s32 ret;
+	__u64 data;
+};
+
+/**
+ * struct fwk_ec_xcmd_batch - Argument of FWK_EC_DEV_IOCXCMD_BATCH.
+ * @count: Number of entries, at most FWK_EC_XCMD_BATCH_MAX.
+ * @flags: Must be zero.
+ * @entries: Pointer to an array of @count struct fwk_ec_xcmd_entry.
+ *
+ * The commands are sent in order and all of them are sent, whatever the
+ * outcome of the previous ones. The sum of the buffer sizes may not exceed
+ * FWK_EC_XCMD_BATCH_MAX_BYTES.
+ */
+struct fwk_ec_xcmd_batch {
+	__u32 count;
+	__u32 flags;
+	__u64 entries;
+};
+
+/**
+ * struct fwk_ec_xcmd_v2 - Argument of FWK_EC_DEV_IOCXCMD_V2.
+ * @version: Command version number (often 0).
+ * @command: Command to send (EC_CMD_...).
+ * @outsize: Outgoing length in bytes.
+ * @insize: Max number of bytes to accept from the EC.
+ * @result: Set to the EC's response to the command.
+ * @flags: Must be zero.
+ * @out: Pointer to the @outsize bytes of the request.
+ * @in: Pointer to a buffer of @insize bytes for the response.
+ * @in_len: Set to the number of bytes received, which are the only ones
+ *          written to @in.
+ * @reserved: Zero.
+ *
+ * Unlike FWK_EC_DEV_IOCXCMD, the request and the response don't share a
+ * buffer, and only the received bytes are copied back. The ioctl returns
+ * the number of bytes received or negative on error.
+ */
+struct fwk_ec_xcmd_v2 {
+	__u32 version;
+	__u32 command;
+	__u32 outsize;
+	__u32 insize;
+	__u32 result;
+	__u32 flags;
+	__u64 out;
+	__u64 in;
+	__u32 in_len;
+	__u32 reserved;
+};
+
+/*
+ * Flags of FWK_EC_DEV_IOCFLAGS.
+ *
+ * FWK_EC_DEV_FLAG_BATCH_READ: read() returns as many whole queued events
+ * as fit in the buffer, instead of one. Each event is a __u8 length, of
+ * the bytes that follow it, then the event type and its payload. read()
+ * fails with EMSGSIZE if not even the first event fits.
+ *
+ * FWK_EC_DEV_FLAG_TIMESTAMPS: read() returns events as struct
+ * fwk_ec_event_record, one per call or, along with
+ * FWK_EC_DEV_FLAG_BATCH_READ, as many as fit in the buffer. read() fails
+ * with EMSGSIZE if the buffer can't hold a record.
+ *
+ * FWK_EC_DEV_FLAG_SHARED_LOG: read() returns the events from the log of
+ * the last 256 events of the device, which all the files share, rather than
+ * from a queue of the file. Each file reads the log from its own position,
+ * set to the end of the log when the flag is set. Events are returned as
+ * with FWK_EC_DEV_FLAG_TIMESTAMPS, with @queue_time_ns the time the event
+ * was logged. A reader which fell behind by more than the log size gets a
+ * record of type FWK_EC_EVENT_LOST in place of the events it missed. The
+ * flag can't be set along with the mmap()ed event ring, nor while the file
+ * has queued events: FWK_EC_DEV_IOCFLAGS fails with EBUSY.
+ */
+#define FWK_EC_DEV_FLAG_BATCH_READ	BIT(0)
+#define FWK_EC_DEV_FLAG_TIMESTAMPS	BIT(1)
+#define FWK_EC_DEV_FLAG_SHARED_LOG	BIT(2)
+#define FWK_EC_DEV_FLAGS		(FWK_EC_DEV_FLAG_BATCH_READ | \
+					 FWK_EC_DEV_FLAG_TIMESTAMPS | \
+					 FWK_EC_DEV_FLAG_SHARED_LOG)
+
+/*
+ * Type of the struct fwk_ec_event_record standing for the events a reader
+ * of the shared log missed. Its @data holds their number as a __u64, in
+ * host byte order, and counts events of all types. @seq is zero.
+ */
+#define FWK_EC_EVENT_LOST		0xff
+
+/**
+ * struct fwk_ec_event_record - Event read() with FWK_EC_DEV_FLAG_TIMESTAMPS.
+ * @seq: Per-device sequence number of the event. Events of types the file
+ *       isn't subscribed to also take a number, see
+ *       FWK_EC_DEV_IOCEVENTSTATS for the events the file lost.
+ * @irq_time_ns: CLOCK_BOOTTIME time the EC signaled the event.
+ * @fetch_time_ns: CLOCK_BOOTTIME time the event was retrieved from the EC.
+ * @queue_time_ns: CLOCK_BOOTTIME time the event was queued to the file.
+ * @event_type: EC_MKBP_EVENT_* type of the event.
+ * @size: Number of valid bytes in @data.
+ * @reserved: Zero.
+ * @data: Event payload, see union ec_response_get_next_data_v1.
+ *
+ * A record an event was coalesced into carries the sequence number and
+ * times of the newest event.
+ */
+struct fwk_ec_event_record {
+	__u64 seq;
+	__u64 irq_time_ns;
+	__u64 fetch_time_ns;
+	__u64 queue_time_ns;
+	__u8 event_type;
+	__u8 size;
+	__u8 reserved[6];
+	__u8 data[16];
+};
+
+/*
+ * Overflow policies of the event queue read() returns events from.
+ *
+ * FWK_EC_EVENT_QUEUE_DROP_NEWEST: events arriving while the queue is full
+ * are dropped.
+ * FWK_EC_EVENT_QUEUE_DROP_OLDEST: the oldest queued event makes room for
+ * the new one.
+ * FWK_EC_EVENT_QUEUE_COALESCE: a new host event or CEC event is OR'ed into
+ * the newest queued event of the same type, a new key matrix, sensor FIFO,
+ * button or switch event replaces it. Other events, and events without a
+ * queued counterpart, are dropped.
+ */
+#define FWK_EC_EVENT_QUEUE_DROP_NEWEST	0
+#define FWK_EC_EVENT_QUEUE_DROP_OLDEST	1
+#define FWK_EC_EVENT_QUEUE_COALESCE	2
+
+/**
+ * struct fwk_ec_event_queue_config - Argument of FWK_EC_DEV_IOCEVENTQUEUE.
+ * @slots: Number of events the queue holds, up to 4096. Zero picks the
+ *         default of 64. When shrinking the queue, the oldest queued events
+ *         which don't fit are dropped.
+ * @policy: FWK_EC_EVENT_QUEUE_* overflow policy.
+ */
+struct fwk_ec_event_queue_config {
+	__u32 slots;
+	__u32 policy;
+};
+
+/**
+ * struct fwk_ec_event_queue_stats - Result of FWK_EC_DEV_IOCEVENTSTATS.
+ * @queued: Events queued since the file was opened.
+ * @dropped_newest: Events dropped because the queue was full.
+ * @dropped_oldest: Queued events dropped to make room for newer ones.
+ * @coalesced: Events folded into a queued one.
+ * @pending: Events currently queued.
+ * @slots: Size of the queue.
+ */
+struct fwk_ec_event_queue_stats {
+	__u64 queued;
+	__u64 dropped_newest;
+	__u64 dropped_oldest;
+	__u64 coalesced;
+	__u32 pending;
+	__u32 slots;
+};
+
+/* mmap() offset of the read-only shadow of the EC memory map. */
+#define FWK_EC_MEMMAP_MMAP_OFFSET	0x80000000UL
+
+/* Layout version of the shadow of the EC memory map. */
+#define FWK_EC_MEMMAP_SHADOW_VERSION	1
+
+/**
+ * struct fwk_ec_memmap_shadow - Page mapped at FWK_EC_MEMMAP_MMAP_OFFSET.
+ * @version: FWK_EC_MEMMAP_SHADOW_VERSION.
+ * @seq: Sequence count, odd while the driver updates the page and zero
+ *       until the first refresh.
+ * @refresh_time_ns: CLOCK_BOOTTIME time of the last refresh.
+ * @size: Number of valid bytes in @data.
+ * @error: Zero, or the negative error code the last refresh failed with.
+ *         @data then holds the previous contents.
+ * @reserved: Zero.
+ * @data: Copy of the EC_MEMMAP_* region, from offset 0.
+ *
+ * All the open files of a device map the same page. The driver refreshes it
+ * periodically as long as it is mapped, but not while the system sleeps.
+ * Readers load @seq (acquire), retry while it is odd, copy what they need,
+ * then load @seq again after a read barrier and retry if it changed.
+ */
+struct fwk_ec_memmap_shadow {
+	__u32 version;
+	__u32 seq;
+	__u64 refresh_time_ns;
+	__u32 size;
+	__s32 error;
+	__u8 reserved[40];
+	__u8 data[EC_MEMMAP_SIZE];
+};
+
+/**
+ * struct fwk_ec_uring_cmd - Payload of an IORING_OP_URING_CMD submission.
+ * @arg: Pointer to the argument of the ioctl in the cmd_op field of the
+ *       submission, FWK_EC_DEV_IOCXCMD, FWK_EC_DEV_IOCXCMD_V2 or
+ *       FWK_EC_DEV_IOCRDMEM.
+ *
+ * The completion carries what the ioctl would have returned. Only kernels
+ * from 6.7 on support it, older ones fail the submission with EOPNOTSUPP.
+ */
+struct fwk_ec_uring_cmd {
+	__u64 arg;
+};
+
 #define FWK_EC_DEV_IOC       0xEC
 #define FWK_EC_DEV_IOCXCMD   _IOWR(FWK_EC_DEV_IOC, 0, struct fwk_ec_command)
 #define FWK_EC_DEV_IOCRDMEM  _IOWR(FWK_EC_DEV_IOC, 1, struct fwk_ec_readmem)
 #define FWK_EC_DEV_IOCEVENTMASK _IO(FWK_EC_DEV_IOC, 2)
+#define FWK_EC_DEV_IOCEVENTRING _IOWR(FWK_EC_DEV_IOC, 3, \
+				      struct fwk_ec_event_ring_setup)
+#define FWK_EC_DEV_IOCFLAGS  _IO(FWK_EC_DEV_IOC, 4)
+#define FWK_EC_DEV_IOCXCMD_BATCH _IOW(FWK_EC_DEV_IOC, 5, \
+				      struct fwk_ec_xcmd_batch)
+#define FWK_EC_DEV_IOCEVENTQUEUE _IOW(FWK_EC_DEV_IOC, 6, \
+				      struct fwk_ec_event_queue_config)
+#define FWK_EC_DEV_IOCEVENTSTATS _IOR(FWK_EC_DEV_IOC, 7, \
+				      struct fwk_ec_event_queue_stats)
+#define FWK_EC_DEV_IOCXCMD_V2 _IOWR(FWK_EC_DEV_IOC, 8, struct fwk_ec_xcmd_v2)
+/*
+ * Takes a pointer to a __u64 of EC_HOST_EVENT_MASK() bits. When non-zero,
+ * EC_MKBP_EVENT_HOST_EVENT and EC_MKBP_EVENT_HOST_EVENT64 events are only
+ * queued to the file if at least one of these host events is pending.
+ */
+#define FWK_EC_DEV_IOCHOSTEVENTMASK _IOW(FWK_EC_DEV_IOC, 9, __u64)
 
 #endif /* _FWK_EC_DEV_H_ */
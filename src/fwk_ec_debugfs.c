@@ -7,6 +7,7 @@
 #include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/fs.h>
+#include <linux/math64.h>
 #include <linux/mod_devicetable.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
@@ -15,6 +16,7 @@
 #include <linux/platform_device.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/wait.h>
 
@@ -29,6 +31,30 @@
 /* waitqueue for log readers */
 static DECLARE_WAIT_QUEUE_HEAD(fwk_ec_debugfs_log_wq);
 
+enum fwk_ec_debugfs_stat {
+	FWK_EC_DEBUGFS_STAT_CONSOLE_FETCHES,
+	FWK_EC_DEBUGFS_STAT_CONSOLE_BYTES,
+	FWK_EC_DEBUGFS_STAT_CONSOLE_ERRORS,
+	FWK_EC_DEBUGFS_STAT_CONSOLE_OVERFLOWS,
+	FWK_EC_DEBUGFS_STAT_PANICINFO_FETCHES,
+	FWK_EC_DEBUGFS_STATS,
+};
+
+static const char * const fwk_ec_debugfs_stat_names[FWK_EC_DEBUGFS_STATS] = {
+	[FWK_EC_DEBUGFS_STAT_CONSOLE_FETCHES] = "console_fetches",
+	[FWK_EC_DEBUGFS_STAT_CONSOLE_BYTES] = "console_bytes",
+	[FWK_EC_DEBUGFS_STAT_CONSOLE_ERRORS] = "console_errors",
+	[FWK_EC_DEBUGFS_STAT_CONSOLE_OVERFLOWS] = "console_overflows",
+	[FWK_EC_DEBUGFS_STAT_PANICINFO_FETCHES] = "panicinfo_fetches",
+};
+
+/* Capabilities are only checked on first access. */
+enum fwk_ec_debugfs_cap {
+	FWK_EC_CAP_UNKNOWN,
+	FWK_EC_CAP_SUPPORTED,
+	FWK_EC_CAP_UNSUPPORTED,
+};
+
 /**
  * struct fwk_ec_debugfs - EC debugging information.
  *
@@ -38,9 +64,18 @@ static DECLARE_WAIT_QUEUE_HEAD(fwk_ec_debugfs_log_wq);
  * @read_msg: preallocated EC command and buffer to read console log
  * @log_mutex: mutex to protect circular buffer
  * @log_poll_work: recurring task to poll EC for new console log data
- * @panicinfo_blob: panicinfo debugfs blob
+ * @panicinfo_blob: panicinfo data, fetched when first opened
  * @notifier_panic: notifier_block to let kernel to flush buffered log
  *                  when EC panic
+ * @lazy_lock: mutex to protect the lazily initialized state below, and
+ *             the allocation of @log_buffer and @read_msg
+ * @console_log_cap: whether the EC supports reading its console
+ * @uptime_cap: whether the EC supports EC_CMD_GET_UPTIME_INFO
+ * @panicinfo_cap: whether the EC supports EC_CMD_GET_PANIC_INFO, known
+ *                 once @panicinfo_blob was fetched
+ * @log_readers: number of opened console_log files, the EC console is
+ *               only polled while there is one
+ * @stats: counters of this driver, see enum fwk_ec_debugfs_stat
  */
 struct fwk_ec_debugfs {
 	struct fwk_ec_dev *ec;
@@ -53,18 +88,21 @@ struct fwk_ec_debugfs {
 	/* EC panicinfo */
 	struct debugfs_blob_wrapper panicinfo_blob;
 	struct notifier_block notifier_panic;
+	/* Lazy initialization */
+	struct mutex lazy_lock;
+	enum fwk_ec_debugfs_cap console_log_cap;
+	enum fwk_ec_debugfs_cap uptime_cap;
+	enum fwk_ec_debugfs_cap panicinfo_cap;
+	unsigned int log_readers;
+	struct fwk_ec_stats_group stats;
 };
 
 /*
  * We need to make sure that the EC log buffer on the UART is large enough,
  * so that it is unlikely enough to overlow within LOG_POLL_SEC.
  */
-static void fwk_ec_console_log_work(struct work_struct *__work)
+static void fwk_ec_console_log_fetch(struct fwk_ec_debugfs *debug_info)
 {
-	struct fwk_ec_debugfs *debug_info =
-		container_of(to_delayed_work(__work),
-			     struct fwk_ec_debugfs,
-			     log_poll_work);
 	struct fwk_ec_dev *ec = debug_info->ec;
 	struct circ_buf *cb = &debug_info->log_buffer;
 	struct fwk_ec_command snapshot_msg = {
@@ -78,9 +116,14 @@ static void fwk_ec_console_log_work(struct work_struct *__work)
 	int buf_space;
 	int ret;
 
+	fwk_ec_stat_inc(&debug_info->stats,
+			FWK_EC_DEBUGFS_STAT_CONSOLE_FETCHES);
 	ret = fwk_ec_cmd_xfer_status(ec->ec_dev, &snapshot_msg);
-	if (ret < 0)
-		goto resched;
+	if (ret < 0) {
+		fwk_ec_stat_inc(&debug_info->stats,
+				FWK_EC_DEBUGFS_STAT_CONSOLE_ERRORS);
+		return;
+	}
 
 	/* Loop until we have read everything, or there's an error. */
 	mutex_lock(&debug_info->log_mutex);
@@ -90,6 +133,8 @@ static void fwk_ec_console_log_work(struct work_struct *__work)
 		if (!buf_space) {
 			dev_info_once(ec->dev,
 				      "Some logs may have been dropped...\n");
+			fwk_ec_stat_inc(&debug_info->stats,
+					FWK_EC_DEBUGFS_STAT_CONSOLE_OVERFLOWS);
 			break;
 		}
 
@@ -97,8 +142,11 @@ static void fwk_ec_console_log_work(struct work_struct *__work)
 		read_params->subcmd = CONSOLE_READ_RECENT;
 		ret = fwk_ec_cmd_xfer_status(ec->ec_dev,
 					      debug_info->read_msg);
-		if (ret < 0)
+		if (ret < 0) {
+			fwk_ec_stat_inc(&debug_info->stats,
+					FWK_EC_DEBUGFS_STAT_CONSOLE_ERRORS);
 			break;
+		}
 
 		/* If the buffer is empty, we're done here. */
 		if (ret == 0 || ec_buffer[0] == '\0')
@@ -111,22 +159,26 @@ static void fwk_ec_console_log_work(struct work_struct *__work)
 			idx++;
 			buf_space--;
 		}
+		fwk_ec_stat_add(&debug_info->stats,
+				FWK_EC_DEBUGFS_STAT_CONSOLE_BYTES, idx);
 
 		wake_up(&fwk_ec_debugfs_log_wq);
 	}
 
 	mutex_unlock(&debug_info->log_mutex);
-
-resched:
-	schedule_delayed_work(&debug_info->log_poll_work,
-			      msecs_to_jiffies(LOG_POLL_SEC * 1000));
 }
 
-static int fwk_ec_console_log_open(struct inode *inode, struct file *file)
+static void fwk_ec_console_log_work(struct work_struct *__work)
 {
-	file->private_data = inode->i_private;
+	struct fwk_ec_debugfs *debug_info =
+		container_of(to_delayed_work(__work),
+			     struct fwk_ec_debugfs,
+			     log_poll_work);
 
-	return stream_open(inode, file);
+	fwk_ec_console_log_fetch(debug_info);
+
+	schedule_delayed_work(&debug_info->log_poll_work,
+			      msecs_to_jiffies(LOG_POLL_SEC * 1000));
 }
 
 static ssize_t fwk_ec_console_log_read(struct file *file, char __user *buf,
@@ -190,11 +242,6 @@ static __poll_t fwk_ec_console_log_poll(struct file *file,
 	return mask;
 }
 
-static int fwk_ec_console_log_release(struct inode *inode, struct file *file)
-{
-	return 0;
-}
-
 static ssize_t fwk_ec_pdinfo_read(struct file *file,
 				   char __user *user_buf,
 				   size_t count,
@@ -266,6 +313,26 @@ static bool fwk_ec_uptime_is_supported(struct fwk_ec_device *ec_dev)
 	return true;
 }
 
+static int fwk_ec_uptime_open(struct inode *inode, struct file *file)
+{
+	struct fwk_ec_debugfs *debug_info = inode->i_private;
+	int ret = 0;
+
+	mutex_lock(&debug_info->lazy_lock);
+	if (debug_info->uptime_cap == FWK_EC_CAP_UNKNOWN)
+		debug_info->uptime_cap =
+			fwk_ec_uptime_is_supported(debug_info->ec->ec_dev) ?
+			FWK_EC_CAP_SUPPORTED : FWK_EC_CAP_UNSUPPORTED;
+	if (debug_info->uptime_cap == FWK_EC_CAP_UNSUPPORTED)
+		ret = -EOPNOTSUPP;
+	mutex_unlock(&debug_info->lazy_lock);
+
+	if (ret)
+		return ret;
+
+	return simple_open(inode, file);
+}
+
 static ssize_t fwk_ec_uptime_read(struct file *file, char __user *user_buf,
 				   size_t count, loff_t *ppos)
 {
@@ -294,15 +361,261 @@ static ssize_t fwk_ec_uptime_read(struct file *file, char __user *user_buf,
 	return simple_read_from_buffer(user_buf, count, ppos, read_buf, ret);
 }
 
-static const struct file_operations fwk_ec_console_log_fops = {
+static ssize_t fwk_ec_event_latency_read(struct file *file,
+					  char __user *user_buf,
+					  size_t count, loff_t *ppos)
+{
+	struct fwk_ec_debugfs *debug_info = file->private_data;
+	struct fwk_ec_latency *lat = &debug_info->ec->ec_dev->event_latency;
+	char read_buf[160];
+	int ret;
+
+	ret = scnprintf(read_buf, sizeof(read_buf),
+			"count: %llu\nlast_ns: %llu\nmin_ns: %llu\nmax_ns: %llu\navg_ns: %llu\n",
+			lat->count, lat->last_ns, lat->min_ns, lat->max_ns,
+			lat->count ? div64_u64(lat->total_ns, lat->count) : 0);
+
+	return simple_read_from_buffer(user_buf, count, ppos, read_buf, ret);
+}
+
+static int fwk_ec_sleep_history_show(struct seq_file *s, void *unused)
+{
+	struct fwk_ec_debugfs *debug_info = s->private;
+	struct fwk_ec_sleep_history *hist =
+		&debug_info->ec->ec_dev->sleep_history;
+	struct fwk_ec_sleep_record *rec;
+	u64 cycle;
+
+	seq_puts(s, "cycle start_ns event suspend_ret suspend_event_ns irq_disable_ns replay_ns replay_events resume_ret resume_event_ns transitions timeout\n");
+
+	mutex_lock(&hist->lock);
+	cycle = hist->count > FWK_EC_SLEEP_HISTORY_SIZE ?
+		hist->count - FWK_EC_SLEEP_HISTORY_SIZE + 1 : 1;
+	for (; cycle <= hist->count; cycle++) {
+		rec = &hist->records[(cycle - 1) % FWK_EC_SLEEP_HISTORY_SIZE];
+		seq_printf(s, "%llu %llu %u %d %llu %llu %llu %u %d %llu %u %d\n",
+			   cycle, rec->start, rec->sleep_event,
+			   rec->suspend_ret, rec->suspend_event_ns,
+			   rec->irq_disable_ns, rec->replay_ns,
+			   rec->replay_events, rec->resume_ret,
+			   rec->resume_event_ns, rec->sleep_transitions,
+			   rec->timeout);
+	}
+	mutex_unlock(&hist->lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fwk_ec_sleep_history);
+
+static int fwk_ec_wake_stats_show(struct seq_file *s, void *unused)
+{
+	struct fwk_ec_debugfs *debug_info = s->private;
+	struct fwk_ec_wake_stats *stats = &debug_info->ec->ec_dev->wake_stats;
+	int i;
+
+	spin_lock(&stats->lock);
+	seq_printf(s, "last_wake_ns: %llu\n", stats->last_wake);
+	seq_puts(s, "host_event seen wakes suppressed\n");
+	for (i = 0; i < ARRAY_SIZE(stats->seen); i++) {
+		if (!stats->seen[i])
+			continue;
+		seq_printf(s, "%d %llu %llu %llu\n", i + 1, stats->seen[i],
+			   stats->wakes[i], stats->suppressed[i]);
+	}
+	spin_unlock(&stats->lock);
+
+	return 0;
+}
+
+static int fwk_ec_bus_stats_show(struct seq_file *s, void *unused)
+{
+	struct fwk_ec_debugfs *debug_info = s->private;
+	struct fwk_ec_bus *bus = &debug_info->ec->ec_dev->bus;
+	struct fwk_ec_bus_target *t;
+	int i;
+
+	seq_puts(s, "target commands wait_avg_ns wait_max_ns service_avg_ns service_max_ns deficit_ns\n");
+
+	spin_lock(&bus->lock);
+	for (i = 0; i < FWK_EC_BUS_TARGETS; i++) {
+		t = &bus->targets[i];
+		if (!t->service.count)
+			continue;
+		seq_printf(s, "%d %llu %llu %llu %llu %llu %lld\n", i,
+			   t->service.count,
+			   div64_u64(t->wait.total_ns, t->wait.count),
+			   t->wait.max_ns,
+			   div64_u64(t->service.total_ns, t->service.count),
+			   t->service.max_ns, t->deficit_ns);
+	}
+	spin_unlock(&bus->lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fwk_ec_bus_stats);
+
+static int fwk_ec_stats_text_show(struct seq_file *s, void *unused)
+{
+	struct fwk_ec_debugfs *debug_info = s->private;
+
+	return fwk_ec_stats_show(debug_info->ec->ec_dev, s);
+}
+DEFINE_SHOW_ATTRIBUTE(fwk_ec_stats_text);
+
+/* The binary statistics are snapshot at open time. */
+static int fwk_ec_stats_bin_open(struct inode *inode, struct file *file)
+{
+	struct fwk_ec_debugfs *debug_info = inode->i_private;
+	struct debugfs_blob_wrapper *blob;
+	size_t size;
+
+	blob = kzalloc(sizeof(*blob), GFP_KERNEL);
+	if (!blob)
+		return -ENOMEM;
+
+	blob->data = fwk_ec_stats_bin(debug_info->ec->ec_dev, &size);
+	if (!blob->data) {
+		kfree(blob);
+		return -ENOMEM;
+	}
+	blob->size = size;
+	file->private_data = blob;
+
+	return 0;
+}
+
+static ssize_t fwk_ec_stats_bin_read(struct file *file, char __user *user_buf,
+				     size_t count, loff_t *ppos)
+{
+	struct debugfs_blob_wrapper *blob = file->private_data;
+
+	return simple_read_from_buffer(user_buf, count, ppos, blob->data,
+				       blob->size);
+}
+
+static int fwk_ec_stats_bin_release(struct inode *inode, struct file *file)
+{
+	struct debugfs_blob_wrapper *blob = file->private_data;
+
+	kvfree(blob->data);
+	kfree(blob);
+
+	return 0;
+}
+
+static const struct file_operations fwk_ec_stats_bin_fops = {
 	.owner = THIS_MODULE,
-	.open = fwk_ec_console_log_open,
-	.read = fwk_ec_console_log_read,
-	.llseek = no_llseek,
-	.poll = fwk_ec_console_log_poll,
-	.release = fwk_ec_console_log_release,
+	.open = fwk_ec_stats_bin_open,
+	.read = fwk_ec_stats_bin_read,
+	.release = fwk_ec_stats_bin_release,
+	.llseek = default_llseek,
+};
+
+static const char * const fwk_ec_bus_class_names[FWK_EC_BUS_CLASSES] = {
+	[FWK_EC_BUS_CLASS_KERNEL] = "kernel",
+	[FWK_EC_BUS_CLASS_EVENT] = "event",
+	[FWK_EC_BUS_CLASS_USER] = "user",
 };
 
+/*
+ * Upper bound, in microseconds, of the wait of the pct percentile command.
+ * Bucket n of the histogram holds the waits below 2^n us.
+ */
+static u64 fwk_ec_bus_class_pct(const struct fwk_ec_bus_class_stats *c,
+				unsigned int pct)
+{
+	u64 rank = div_u64(c->wait.count * pct + 99, 100);
+	u64 seen = 0;
+	int i;
+
+	for (i = 0; i < FWK_EC_BUS_HIST_BUCKETS - 1; i++) {
+		seen += c->hist[i];
+		if (seen >= rank)
+			break;
+	}
+
+	return 1ULL << i;
+}
+
+static int fwk_ec_bus_class_stats_show(struct seq_file *s, void *unused)
+{
+	struct fwk_ec_debugfs *debug_info = s->private;
+	struct fwk_ec_bus *bus = &debug_info->ec->ec_dev->bus;
+	struct fwk_ec_bus_class_stats c;
+	int i;
+
+	seq_printf(s, "fifo %d\n", READ_ONCE(bus->fifo));
+	seq_puts(s, "class commands wait_avg_ns wait_max_ns p50_us p90_us p99_us\n");
+
+	for (i = 0; i < FWK_EC_BUS_CLASSES; i++) {
+		spin_lock(&bus->lock);
+		c = bus->classes[i];
+		spin_unlock(&bus->lock);
+
+		if (!c.wait.count)
+			continue;
+		seq_printf(s, "%s %llu %llu %llu %llu %llu %llu\n",
+			   fwk_ec_bus_class_names[i], c.wait.count,
+			   div64_u64(c.wait.total_ns, c.wait.count),
+			   c.wait.max_ns, fwk_ec_bus_class_pct(&c, 50),
+			   fwk_ec_bus_class_pct(&c, 90),
+			   fwk_ec_bus_class_pct(&c, 99));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fwk_ec_bus_class_stats);
+
+static int fwk_ec_host_event_masks_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[FWK_EC_HOST_EVENT_MASKS] = {
+		"sci", "smi", "wake", "lazy_wake_s0ix", "lazy_wake_s3",
+	};
+	struct fwk_ec_debugfs *debug_info = s->private;
+	struct fwk_ec_host_event_masks *masks =
+		&debug_info->ec->ec_dev->host_event_masks;
+	struct fwk_ec_host_event_mask *m;
+	int i;
+
+	mutex_lock(&masks->lock);
+	seq_puts(s, "mask value base requested\n");
+	for (i = 0; i < FWK_EC_HOST_EVENT_MASKS; i++) {
+		m = &masks->masks[i];
+		if (!m->valid)
+			continue;
+		seq_printf(s, "%s 0x%016llx 0x%016llx 0x%016llx\n", names[i],
+			   m->value, m->base, m->requested);
+	}
+	mutex_unlock(&masks->lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fwk_ec_host_event_masks);
+
+static int fwk_ec_wake_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fwk_ec_wake_stats_show, inode->i_private);
+}
+
+/* Any write resets the counters. */
+static ssize_t fwk_ec_wake_stats_write(struct file *file,
+				       const char __user *user_buf,
+				       size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct fwk_ec_debugfs *debug_info = s->private;
+	struct fwk_ec_wake_stats *stats = &debug_info->ec->ec_dev->wake_stats;
+
+	spin_lock(&stats->lock);
+	memset(stats->seen, 0, sizeof(stats->seen));
+	memset(stats->wakes, 0, sizeof(stats->wakes));
+	memset(stats->suppressed, 0, sizeof(stats->suppressed));
+	stats->last_wake = 0;
+	spin_unlock(&stats->lock);
+
+	return count;
+}
+
 static const struct file_operations fwk_ec_pdinfo_fops = {
 	.owner = THIS_MODULE,
 	.open = simple_open,
@@ -312,11 +625,78 @@ static const struct file_operations fwk_ec_pdinfo_fops = {
 
 static const struct file_operations fwk_ec_uptime_fops = {
 	.owner = THIS_MODULE,
-	.open = simple_open,
+	.open = fwk_ec_uptime_open,
 	.read = fwk_ec_uptime_read,
 	.llseek = default_llseek,
 };
 
+static const struct file_operations fwk_ec_wake_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = fwk_ec_wake_stats_open,
+	.read = seq_read,
+	.write = fwk_ec_wake_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int fwk_ec_irq_poll_budget_get(void *data, u64 *val)
+{
+	struct fwk_ec_irq_poll *poll = data;
+
+	*val = READ_ONCE(poll->budget);
+	return 0;
+}
+
+static int fwk_ec_irq_poll_budget_set(void *data, u64 val)
+{
+	struct fwk_ec_irq_poll *poll = data;
+
+	if (!val || val > FWK_EC_IRQ_POLL_BUDGET_MAX)
+		return -EINVAL;
+
+	mutex_lock(&poll->lock);
+	poll->budget = val;
+	mutex_unlock(&poll->lock);
+	return 0;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(fwk_ec_irq_poll_budget_fops,
+			 fwk_ec_irq_poll_budget_get,
+			 fwk_ec_irq_poll_budget_set, "%llu\n");
+
+static int fwk_ec_irq_poll_interval_get(void *data, u64 *val)
+{
+	struct fwk_ec_irq_poll *poll = data;
+
+	*val = READ_ONCE(poll->interval_us);
+	return 0;
+}
+
+static int fwk_ec_irq_poll_interval_set(void *data, u64 val)
+{
+	struct fwk_ec_irq_poll *poll = data;
+
+	if (val < FWK_EC_IRQ_POLL_INTERVAL_MIN_US ||
+	    val > FWK_EC_IRQ_POLL_INTERVAL_MAX_US)
+		return -EINVAL;
+
+	mutex_lock(&poll->lock);
+	poll->interval_us = val;
+	mutex_unlock(&poll->lock);
+	return 0;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(fwk_ec_irq_poll_interval_fops,
+			 fwk_ec_irq_poll_interval_get,
+			 fwk_ec_irq_poll_interval_set, "%llu\n");
+
+static const struct file_operations fwk_ec_event_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = fwk_ec_event_latency_read,
+	.llseek = default_llseek,
+};
+
 static int ec_read_version_supported(struct fwk_ec_dev *ec)
 {
 	struct ec_params_get_cmd_versions_v1 *params;
@@ -346,59 +726,105 @@ static int ec_read_version_supported(struct fwk_ec_dev *ec)
 	return ret;
 }
 
-static int fwk_ec_create_console_log(struct fwk_ec_debugfs *debug_info)
+/*
+ * Allocate the console log buffers the first time they are needed.
+ * Called with lazy_lock held.
+ */
+static int fwk_ec_console_log_init(struct fwk_ec_debugfs *debug_info)
 {
 	struct fwk_ec_dev *ec = debug_info->ec;
 	char *buf;
 	int read_params_size;
 	int read_response_size;
 
-	/*
-	 * If the console log feature is not supported return silently and
-	 * don't create the console_log entry.
-	 */
-	if (!ec_read_version_supported(ec))
+	if (debug_info->console_log_cap == FWK_EC_CAP_UNKNOWN)
+		debug_info->console_log_cap = ec_read_version_supported(ec) ?
+			FWK_EC_CAP_SUPPORTED : FWK_EC_CAP_UNSUPPORTED;
+	if (debug_info->console_log_cap == FWK_EC_CAP_UNSUPPORTED)
+		return -EOPNOTSUPP;
+
+	if (debug_info->log_buffer.buf)
 		return 0;
 
+	/*
+	 * The log buffer goes first, so that failing to allocate it doesn't
+	 * leave an extra read_msg behind on every retry.
+	 */
 	buf = devm_kzalloc(ec->dev, LOG_SIZE, GFP_KERNEL);
 	if (!buf)
 		return -ENOMEM;
 
-	read_params_size = sizeof(struct ec_params_console_read_v1);
-	read_response_size = ec->ec_dev->max_response;
-	debug_info->read_msg = devm_kzalloc(ec->dev,
-		sizeof(*debug_info->read_msg) +
-			max(read_params_size, read_response_size), GFP_KERNEL);
-	if (!debug_info->read_msg)
-		return -ENOMEM;
+	if (!debug_info->read_msg) {
+		read_params_size = sizeof(struct ec_params_console_read_v1);
+		read_response_size = ec->ec_dev->max_response;
+		debug_info->read_msg = devm_kzalloc(ec->dev,
+			sizeof(*debug_info->read_msg) +
+				max(read_params_size, read_response_size),
+			GFP_KERNEL);
+		if (!debug_info->read_msg) {
+			devm_kfree(ec->dev, buf);
+			return -ENOMEM;
+		}
 
-	debug_info->read_msg->version = 1;
-	debug_info->read_msg->command = EC_CMD_CONSOLE_READ + ec->cmd_offset;
-	debug_info->read_msg->outsize = read_params_size;
-	debug_info->read_msg->insize = read_response_size;
+		debug_info->read_msg->version = 1;
+		debug_info->read_msg->command = EC_CMD_CONSOLE_READ +
+						ec->cmd_offset;
+		debug_info->read_msg->outsize = read_params_size;
+		debug_info->read_msg->insize = read_response_size;
+	}
 
 	debug_info->log_buffer.buf = buf;
 	debug_info->log_buffer.head = 0;
 	debug_info->log_buffer.tail = 0;
 
-	mutex_init(&debug_info->log_mutex);
+	return 0;
+}
 
-	debugfs_create_file("console_log", S_IFREG | 0444, debug_info->dir,
-			    debug_info, &fwk_ec_console_log_fops);
+static int fwk_ec_console_log_open(struct inode *inode, struct file *file)
+{
+	struct fwk_ec_debugfs *debug_info = inode->i_private;
+	int ret;
 
-	INIT_DELAYED_WORK(&debug_info->log_poll_work,
-			  fwk_ec_console_log_work);
-	schedule_delayed_work(&debug_info->log_poll_work, 0);
+	mutex_lock(&debug_info->lazy_lock);
+	ret = fwk_ec_console_log_init(debug_info);
+	/* Only poll the EC console while somebody reads it. */
+	if (!ret && !debug_info->log_readers++)
+		schedule_delayed_work(&debug_info->log_poll_work, 0);
+	mutex_unlock(&debug_info->lazy_lock);
+
+	if (ret)
+		return ret;
+
+	file->private_data = debug_info;
+
+	return stream_open(inode, file);
+}
+
+static int fwk_ec_console_log_release(struct inode *inode, struct file *file)
+{
+	struct fwk_ec_debugfs *debug_info = file->private_data;
+
+	mutex_lock(&debug_info->lazy_lock);
+	if (!--debug_info->log_readers)
+		cancel_delayed_work_sync(&debug_info->log_poll_work);
+	mutex_unlock(&debug_info->lazy_lock);
 
 	return 0;
 }
 
+static const struct file_operations fwk_ec_console_log_fops = {
+	.owner = THIS_MODULE,
+	.open = fwk_ec_console_log_open,
+	.read = fwk_ec_console_log_read,
+	.llseek = no_llseek,
+	.poll = fwk_ec_console_log_poll,
+	.release = fwk_ec_console_log_release,
+};
+
 static void fwk_ec_cleanup_console_log(struct fwk_ec_debugfs *debug_info)
 {
-	if (debug_info->log_buffer.buf) {
-		cancel_delayed_work_sync(&debug_info->log_poll_work);
-		mutex_destroy(&debug_info->log_mutex);
-	}
+	cancel_delayed_work_sync(&debug_info->log_poll_work);
+	mutex_destroy(&debug_info->log_mutex);
 }
 
 /*
@@ -431,12 +857,24 @@ free:
 	return ret;
 }
 
-static int fwk_ec_create_panicinfo(struct fwk_ec_debugfs *debug_info)
+/*
+ * Fetch the panicinfo the first time it is needed. Called with lazy_lock
+ * held. An EC without panic data leaves an empty blob.
+ */
+static int fwk_ec_panicinfo_init(struct fwk_ec_debugfs *debug_info)
 {
 	struct fwk_ec_device *ec_dev = debug_info->ec->ec_dev;
 	int ret;
 	void *data;
 
+	if (debug_info->panicinfo_cap == FWK_EC_CAP_SUPPORTED)
+		return 0;
+	if (debug_info->panicinfo_cap == FWK_EC_CAP_UNSUPPORTED)
+		return -EOPNOTSUPP;
+
+	fwk_ec_stat_inc(&debug_info->stats,
+			FWK_EC_DEBUGFS_STAT_PANICINFO_FETCHES);
+
 	data = devm_kzalloc(debug_info->ec->dev, ec_dev->max_response,
 			    GFP_KERNEL);
 	if (!data)
@@ -444,39 +882,69 @@ static int fwk_ec_create_panicinfo(struct fwk_ec_debugfs *debug_info)
 
 	ret = fwk_ec_get_panicinfo(ec_dev, data, ec_dev->max_response);
 	if (ret < 0) {
-		ret = 0;
-		goto free;
+		devm_kfree(debug_info->ec->dev, data);
+		/* Other errors may be transient, do not rule about support. */
+		if (ret == -EOPNOTSUPP)
+			debug_info->panicinfo_cap = FWK_EC_CAP_UNSUPPORTED;
+		return ret;
 	}
 
-	/* No panic data */
-	if (ret == 0)
-		goto free;
-
 	debug_info->panicinfo_blob.data = data;
 	debug_info->panicinfo_blob.size = ret;
-
-	debugfs_create_blob("panicinfo", 0444, debug_info->dir,
-			    &debug_info->panicinfo_blob);
+	debug_info->panicinfo_cap = FWK_EC_CAP_SUPPORTED;
 
 	return 0;
+}
 
-free:
-	devm_kfree(debug_info->ec->dev, data);
-	return ret;
+static int fwk_ec_panicinfo_open(struct inode *inode, struct file *file)
+{
+	struct fwk_ec_debugfs *debug_info = inode->i_private;
+	int ret;
+
+	mutex_lock(&debug_info->lazy_lock);
+	ret = fwk_ec_panicinfo_init(debug_info);
+	mutex_unlock(&debug_info->lazy_lock);
+
+	if (ret)
+		return ret;
+
+	return simple_open(inode, file);
+}
+
+static ssize_t fwk_ec_panicinfo_read(struct file *file, char __user *user_buf,
+				     size_t count, loff_t *ppos)
+{
+	struct fwk_ec_debugfs *debug_info = file->private_data;
+
+	return simple_read_from_buffer(user_buf, count, ppos,
+				       debug_info->panicinfo_blob.data,
+				       debug_info->panicinfo_blob.size);
 }
 
+static const struct file_operations fwk_ec_panicinfo_fops = {
+	.owner = THIS_MODULE,
+	.open = fwk_ec_panicinfo_open,
+	.read = fwk_ec_panicinfo_read,
+	.llseek = default_llseek,
+};
+
 static int fwk_ec_debugfs_panic_event(struct notifier_block *nb,
 				       unsigned long queued_during_suspend, void *_notify)
 {
 	struct fwk_ec_debugfs *debug_info =
 		container_of(nb, struct fwk_ec_debugfs, notifier_panic);
 
-	if (debug_info->log_buffer.buf) {
+	mutex_lock(&debug_info->lazy_lock);
+	if (debug_info->log_readers) {
 		/* Force log poll work to run immediately */
 		mod_delayed_work(debug_info->log_poll_work.wq, &debug_info->log_poll_work, 0);
 		/* Block until log poll work finishes */
 		flush_delayed_work(&debug_info->log_poll_work);
+	} else if (!fwk_ec_console_log_init(debug_info)) {
+		/* Keep the last words of the EC for a later reader. */
+		fwk_ec_console_log_fetch(debug_info);
 	}
+	mutex_unlock(&debug_info->lazy_lock);
 
 	return NOTIFY_DONE;
 }
@@ -494,22 +962,38 @@ static int fwk_ec_debugfs_probe(struct platform_device *pd)
 		return -ENOMEM;
 
 	debug_info->ec = ec;
-	debug_info->dir = debugfs_create_dir(name, NULL);
+	mutex_init(&debug_info->lazy_lock);
+	mutex_init(&debug_info->log_mutex);
+	INIT_DELAYED_WORK(&debug_info->log_poll_work,
+			  fwk_ec_console_log_work);
 
-	ret = fwk_ec_create_panicinfo(debug_info);
+	debug_info->stats.name = devm_kasprintf(ec->dev, GFP_KERNEL,
+						"debugfs.%s", name);
+	if (!debug_info->stats.name)
+		return -ENOMEM;
+	debug_info->stats.names = fwk_ec_debugfs_stat_names;
+	debug_info->stats.count = FWK_EC_DEBUGFS_STATS;
+	ret = devm_fwk_ec_stats_group_init(ec->dev, &debug_info->stats);
 	if (ret)
-		goto remove_debugfs;
+		return ret;
 
-	ret = fwk_ec_create_console_log(debug_info);
-	if (ret)
-		goto remove_debugfs;
+	/*
+	 * Nothing is read from the EC until a file is opened: most machines
+	 * never look at these.
+	 */
+	debug_info->dir = debugfs_create_dir(name, NULL);
+
+	debugfs_create_file("panicinfo", 0444, debug_info->dir, debug_info,
+			    &fwk_ec_panicinfo_fops);
+
+	debugfs_create_file("console_log", S_IFREG | 0444, debug_info->dir,
+			    debug_info, &fwk_ec_console_log_fops);
 
 	debugfs_create_file("pdinfo", 0444, debug_info->dir, debug_info,
 			    &fwk_ec_pdinfo_fops);
 
-	if (fwk_ec_uptime_is_supported(ec->ec_dev))
-		debugfs_create_file("uptime", 0444, debug_info->dir, debug_info,
-				    &fwk_ec_uptime_fops);
+	debugfs_create_file("uptime", 0444, debug_info->dir, debug_info,
+			    &fwk_ec_uptime_fops);
 
 	debugfs_create_x32("last_resume_result", 0444, debug_info->dir,
 			   &ec->ec_dev->last_resume_result);
@@ -517,6 +1001,48 @@ static int fwk_ec_debugfs_probe(struct platform_device *pd)
 	debugfs_create_u16("suspend_timeout_ms", 0664, debug_info->dir,
 			   &ec->ec_dev->suspend_timeout_ms);
 
+	debugfs_create_u64("event_ring_overruns", 0444, debug_info->dir,
+			   &ec->ec_dev->event_ring.overruns);
+
+	debugfs_create_file("sleep_history", 0444, debug_info->dir, debug_info,
+			    &fwk_ec_sleep_history_fops);
+
+	debugfs_create_file("bus_stats", 0444, debug_info->dir, debug_info,
+			    &fwk_ec_bus_stats_fops);
+	debugfs_create_u32("bus_quantum_us", 0664, debug_info->dir,
+			   &ec->ec_dev->bus.quantum_us);
+	debugfs_create_file("bus_class_stats", 0444, debug_info->dir,
+			    debug_info, &fwk_ec_bus_class_stats_fops);
+	debugfs_create_bool("bus_fifo", 0664, debug_info->dir,
+			    &ec->ec_dev->bus.fifo);
+
+	debugfs_create_file("stats", 0444, debug_info->dir, debug_info,
+			    &fwk_ec_stats_text_fops);
+	debugfs_create_file("stats.bin", 0444, debug_info->dir, debug_info,
+			    &fwk_ec_stats_bin_fops);
+
+	debugfs_create_file("host_event_masks", 0444, debug_info->dir,
+			    debug_info, &fwk_ec_host_event_masks_fops);
+
+	debugfs_create_file("wake_stats", 0644, debug_info->dir, debug_info,
+			    &fwk_ec_wake_stats_fops);
+
+	debugfs_create_file("event_latency", 0444, debug_info->dir, debug_info,
+			    &fwk_ec_event_latency_fops);
+
+	debugfs_create_u32("irq_poll_threshold", 0664, debug_info->dir,
+			   &ec->ec_dev->irq_poll.threshold);
+	debugfs_create_file_unsafe("irq_poll_budget", 0664, debug_info->dir,
+				   &ec->ec_dev->irq_poll,
+				   &fwk_ec_irq_poll_budget_fops);
+	debugfs_create_file_unsafe("irq_poll_interval_us", 0664,
+				   debug_info->dir, &ec->ec_dev->irq_poll,
+				   &fwk_ec_irq_poll_interval_fops);
+	debugfs_create_u64("irq_poll_enter_count", 0444, debug_info->dir,
+			   &ec->ec_dev->irq_poll.enter_count);
+	debugfs_create_u64("irq_poll_exit_count", 0444, debug_info->dir,
+			   &ec->ec_dev->irq_poll.exit_count);
+
 	debug_info->notifier_panic.notifier_call = fwk_ec_debugfs_panic_event;
 	ret = blocking_notifier_chain_register(&ec->ec_dev->panic_notifier,
 					       &debug_info->notifier_panic);
@@ -524,6 +1050,7 @@ static int fwk_ec_debugfs_probe(struct platform_device *pd)
 		goto remove_debugfs;
 
 	ec->debug_info = debug_info;
+	fwk_ec_stats_register(ec->ec_dev, &debug_info->stats);
 
 	dev_set_drvdata(&pd->dev, ec);
 
@@ -531,6 +1058,8 @@ static int fwk_ec_debugfs_probe(struct platform_device *pd)
 
 remove_debugfs:
 	debugfs_remove_recursive(debug_info->dir);
+	fwk_ec_cleanup_console_log(debug_info);
+	mutex_destroy(&debug_info->lazy_lock);
 	return ret;
 }
 
@@ -538,16 +1067,17 @@ static void fwk_ec_debugfs_remove(struct platform_device *pd)
 {
 	struct fwk_ec_dev *ec = dev_get_drvdata(pd->dev.parent);
 
+	fwk_ec_stats_unregister(ec->ec_dev, &ec->debug_info->stats);
 	debugfs_remove_recursive(ec->debug_info->dir);
 	fwk_ec_cleanup_console_log(ec->debug_info);
+	mutex_destroy(&ec->debug_info->lazy_lock);
 }
 
 static int __maybe_unused fwk_ec_debugfs_suspend(struct device *dev)
 {
 	struct fwk_ec_dev *ec = dev_get_drvdata(dev);
 
-	if (ec->debug_info->log_buffer.buf)
-		cancel_delayed_work_sync(&ec->debug_info->log_poll_work);
+	cancel_delayed_work_sync(&ec->debug_info->log_poll_work);
 
 	return 0;
 }
@@ -556,8 +1086,10 @@ static int __maybe_unused fwk_ec_debugfs_resume(struct device *dev)
 {
 	struct fwk_ec_dev *ec = dev_get_drvdata(dev);
 
-	if (ec->debug_info->log_buffer.buf)
+	mutex_lock(&ec->debug_info->lazy_lock);
+	if (ec->debug_info->log_readers)
 		schedule_delayed_work(&ec->debug_info->log_poll_work, 0);
+	mutex_unlock(&ec->debug_info->lazy_lock);
 
 	return 0;
 }
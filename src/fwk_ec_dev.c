@@ -5,6 +5,7 @@
  * Copyright (C) 2014 Google, Inc.
  */
 
+#include <linux/async.h>
 #include <linux/dmi.h>
 #include <linux/kconfig.h>
 #include <linux/mfd/core.h>
@@ -150,6 +151,48 @@ static void fwk_ec_class_release(struct device *dev)
 	kfree(to_fwk_ec_dev(dev));
 }
 
+/**
+ * struct fwk_ec_dev_cells - Group of mfd cells to register.
+ * @ec: The EC device the cells belong to.
+ * @mfd_cells: Cells to register.
+ * @num_cells: Number of cells in @mfd_cells.
+ */
+struct fwk_ec_dev_cells {
+	struct fwk_ec_dev *ec;
+	const struct mfd_cell *mfd_cells;
+	unsigned int num_cells;
+};
+
+/*
+ * Most cells are registered from async threads: binding them can take a
+ * while and none of them depends on the others. Our cells have no OF
+ * compatible, so concurrent mfd_add_hotplug_devices() calls don't share
+ * any state. Each probe schedules them in an async domain of its own, and
+ * only waits for that domain: the probe is an async entry itself.
+ */
+static void fwk_ec_dev_add_cells(void *data, async_cookie_t cookie)
+{
+	struct fwk_ec_dev_cells *group = data;
+	int retval;
+
+	retval = mfd_add_hotplug_devices(group->ec->dev, group->mfd_cells,
+					 group->num_cells);
+	if (retval)
+		dev_warn(group->ec->dev, "failed to add %s subdevice: %d\n",
+			 group->mfd_cells->name, retval);
+}
+
+static void fwk_ec_dev_group_cells(struct fwk_ec_dev_cells *groups,
+				   unsigned int *num_groups,
+				   struct fwk_ec_dev *ec,
+				   const struct mfd_cell *cells,
+				   unsigned int num_cells)
+{
+	groups[(*num_groups)++] = (struct fwk_ec_dev_cells) {
+		.ec = ec, .mfd_cells = cells, .num_cells = num_cells,
+	};
+}
+
 static int ec_device_probe(struct platform_device *pdev)
 {
 	int retval = -ENOMEM;
@@ -157,7 +200,11 @@ static int ec_device_probe(struct platform_device *pdev)
 	struct device *dev = &pdev->dev;
 	struct fwk_ec_platform *ec_platform = dev_get_platdata(dev);
 	struct fwk_ec_dev *ec = kzalloc(sizeof(*ec), GFP_KERNEL);
+	struct fwk_ec_dev_cells groups[ARRAY_SIZE(fwk_subdevices) + 6];
 	struct ec_response_pchg_count pchg_count;
+	unsigned int num_groups = 0;
+	ktime_t start = ktime_get();
+	ASYNC_DOMAIN_EXCLUSIVE(async_domain);
 	int i;
 
 	if (!ec)
@@ -167,8 +214,7 @@ static int ec_device_probe(struct platform_device *pdev)
 	ec->ec_dev = dev_get_drvdata(dev->parent);
 	ec->dev = dev;
 	ec->cmd_offset = ec_platform->cmd_offset;
-	ec->features.flags[0] = -1U; /* Not cached yet */
-	ec->features.flags[1] = -1U; /* Not cached yet */
+	mutex_init(&ec->features_lock);
 	device_initialize(&ec->class_dev);
 
 	for (i = 0; i < ARRAY_SIZE(fwk_mcu_devices); i++) {
@@ -206,30 +252,20 @@ static int ec_device_probe(struct platform_device *pdev)
 		goto failed;
 
 	/* check whether this EC is a sensor hub. */
-	if (fwk_ec_get_sensor_count(ec) > 0) {
-		retval = mfd_add_hotplug_devices(ec->dev,
-				fwk_ec_sensorhub_cells,
-				ARRAY_SIZE(fwk_ec_sensorhub_cells));
-		if (retval)
-			dev_err(ec->dev, "failed to add %s subdevice: %d\n",
-				fwk_ec_sensorhub_cells->name, retval);
-	}
+	if (fwk_ec_get_sensor_count(ec) > 0)
+		fwk_ec_dev_group_cells(groups, &num_groups, ec,
+				       fwk_ec_sensorhub_cells,
+				       ARRAY_SIZE(fwk_ec_sensorhub_cells));
 
 	/*
 	 * The following subdevices can be detected by sending the
 	 * EC_FEATURE_GET_CMD Embedded Controller device.
 	 */
 	for (i = 0; i < ARRAY_SIZE(fwk_subdevices); i++) {
-		if (fwk_ec_check_features(ec, fwk_subdevices[i].id)) {
-			retval = mfd_add_hotplug_devices(ec->dev,
-						fwk_subdevices[i].mfd_cells,
-						fwk_subdevices[i].num_cells);
-			if (retval)
-				dev_err(ec->dev,
-					"failed to add %s subdevice: %d\n",
-					fwk_subdevices[i].mfd_cells->name,
-					retval);
-		}
+		if (fwk_ec_check_features(ec, fwk_subdevices[i].id))
+			fwk_ec_dev_group_cells(groups, &num_groups, ec,
+					       fwk_subdevices[i].mfd_cells,
+					       fwk_subdevices[i].num_cells);
 	}
 
 	/*
@@ -237,31 +273,21 @@ static int ec_device_probe(struct platform_device *pdev)
 	 * but older ones do not.
 	 */
 	if (fwk_ec_check_features(ec, EC_FEATURE_LIGHTBAR) ||
-	    dmi_match(DMI_PRODUCT_NAME, "Link")) {
-		retval = mfd_add_hotplug_devices(ec->dev,
-					fwk_ec_lightbar_cells,
-					ARRAY_SIZE(fwk_ec_lightbar_cells));
-		if (retval)
-			dev_warn(ec->dev, "failed to add lightbar: %d\n",
-				 retval);
-	}
+	    dmi_match(DMI_PRODUCT_NAME, "Link"))
+		fwk_ec_dev_group_cells(groups, &num_groups, ec,
+				       fwk_ec_lightbar_cells,
+				       ARRAY_SIZE(fwk_ec_lightbar_cells));
 
 	/*
 	 * The PD notifier driver cell is separate since it only needs to be
 	 * explicitly added on platforms that don't have the PD notifier ACPI
 	 * device entry defined.
 	 */
-	if (IS_ENABLED(CONFIG_OF) && ec->ec_dev->dev->of_node) {
-		if (fwk_ec_check_features(ec, EC_FEATURE_USB_PD)) {
-			retval = mfd_add_hotplug_devices(ec->dev,
-					fwk_usbpd_notify_cells,
-					ARRAY_SIZE(fwk_usbpd_notify_cells));
-			if (retval)
-				dev_err(ec->dev,
-					"failed to add PD notify devices: %d\n",
-					retval);
-		}
-	}
+	if (IS_ENABLED(CONFIG_OF) && ec->ec_dev->dev->of_node &&
+	    fwk_ec_check_features(ec, EC_FEATURE_USB_PD))
+		fwk_ec_dev_group_cells(groups, &num_groups, ec,
+				       fwk_usbpd_notify_cells,
+				       ARRAY_SIZE(fwk_usbpd_notify_cells));
 
 	/*
 	 * The PCHG device cannot be detected by sending EC_FEATURE_GET_CMD, but
@@ -269,35 +295,33 @@ static int ec_device_probe(struct platform_device *pdev)
 	 */
 	retval = fwk_ec_cmd(ec->ec_dev, 0, EC_CMD_PCHG_COUNT, NULL, 0,
 			     &pchg_count, sizeof(pchg_count));
-	if (retval >= 0 && pchg_count.port_count) {
-		retval = mfd_add_hotplug_devices(ec->dev,
-					fwk_ec_pchg_cells,
-					ARRAY_SIZE(fwk_ec_pchg_cells));
-		if (retval)
-			dev_warn(ec->dev, "failed to add pchg: %d\n",
-				 retval);
-	}
+	if (retval >= 0 && pchg_count.port_count)
+		fwk_ec_dev_group_cells(groups, &num_groups, ec,
+				       fwk_ec_pchg_cells,
+				       ARRAY_SIZE(fwk_ec_pchg_cells));
 
 	/*
 	 * The following subdevices cannot be detected by sending the
 	 * EC_FEATURE_GET_CMD to the Embedded Controller device.
 	 */
-	retval = mfd_add_hotplug_devices(ec->dev, fwk_ec_platform_cells,
-					 ARRAY_SIZE(fwk_ec_platform_cells));
-	if (retval)
-		dev_warn(ec->dev,
-			 "failed to add fwk-ec platform devices: %d\n",
-			 retval);
+	fwk_ec_dev_group_cells(groups, &num_groups, ec, fwk_ec_platform_cells,
+			       ARRAY_SIZE(fwk_ec_platform_cells));
 
 	/* Check whether this EC instance has a VBC NVRAM */
 	node = ec->ec_dev->dev->of_node;
-	if (of_property_read_bool(node, "google,has-vbc-nvram")) {
-		retval = mfd_add_hotplug_devices(ec->dev, fwk_ec_vbc_cells,
-						ARRAY_SIZE(fwk_ec_vbc_cells));
-		if (retval)
-			dev_warn(ec->dev, "failed to add VBC devices: %d\n",
-				 retval);
-	}
+	if (of_property_read_bool(node, "google,has-vbc-nvram"))
+		fwk_ec_dev_group_cells(groups, &num_groups, ec,
+				       fwk_ec_vbc_cells,
+				       ARRAY_SIZE(fwk_ec_vbc_cells));
+
+	/* Everything is known by now, register the cells concurrently. */
+	for (i = 0; i < num_groups; i++)
+		async_schedule_domain(fwk_ec_dev_add_cells, &groups[i],
+				      &async_domain);
+	async_synchronize_full_domain(&async_domain);
+
+	dev_dbg(dev, "probed in %lld us\n",
+		ktime_us_delta(ktime_get(), start));
 
 	return 0;
 
@@ -323,6 +347,8 @@ MODULE_DEVICE_TABLE(platform, fwk_ec_id);
 static struct platform_driver fwk_ec_dev_driver = {
 	.driver = {
 		.name = DRV_NAME,
+		/* Lets the EC and the PD behind it probe in parallel. */
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.id_table = fwk_ec_id,
 	.probe = ec_device_probe,
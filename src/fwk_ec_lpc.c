@@ -54,12 +54,31 @@ struct lpc_driver_data {
 	const char *aml_mutex_name;
 };
 
+enum fwk_ec_lpc_stat {
+	FWK_EC_LPC_STAT_TIMEOUTS,
+	FWK_EC_LPC_STAT_CHECKSUM_ERRORS,
+	FWK_EC_LPC_STAT_OVERSIZE_RESPONSES,
+	FWK_EC_LPC_STAT_READMEM_BYTES,
+	FWK_EC_LPC_STATS,
+};
+
+static const char * const fwk_ec_lpc_stat_names[FWK_EC_LPC_STATS] = {
+	[FWK_EC_LPC_STAT_TIMEOUTS] = "timeouts",
+	[FWK_EC_LPC_STAT_CHECKSUM_ERRORS] = "checksum_errors",
+	[FWK_EC_LPC_STAT_OVERSIZE_RESPONSES] = "oversize_responses",
+	[FWK_EC_LPC_STAT_READMEM_BYTES] = "readmem_bytes",
+};
+
 /**
  * struct fwk_ec_lpc - LPC device-specific data
  * @mmio_memory_base: The first I/O port addressing EC mapped memory.
+ * @stats: Transport counters, see enum fwk_ec_lpc_stat.
+ * @mec_stats: EMI counters of the MEC variant, see enum fwk_ec_lpc_mec_stat.
  */
 struct fwk_ec_lpc {
 	u16 mmio_memory_base;
+	struct fwk_ec_stats_group stats;
+	struct fwk_ec_stats_group mec_stats;
 };
 
 /**
@@ -70,8 +89,10 @@ struct fwk_ec_lpc {
  *         the 8-bit checksum of all bytes written.
  */
 struct lpc_driver_ops {
-	int (*read)(unsigned int offset, unsigned int length, u8 *dest);
-	int (*write)(unsigned int offset, unsigned int length, const u8 *msg);
+	int (*read)(struct fwk_ec_lpc *ec_lpc, unsigned int offset,
+		    unsigned int length, u8 *dest);
+	int (*write)(struct fwk_ec_lpc *ec_lpc, unsigned int offset,
+		     unsigned int length, const u8 *msg);
 };
 
 static struct lpc_driver_ops fwk_ec_lpc_ops = { };
@@ -82,8 +103,9 @@ static const struct lpc_driver_data *fwk_ec_lpc_driver_data;
  * A generic instance of the read function of struct lpc_driver_ops, used for
  * the LPC EC.
  */
-static int fwk_ec_lpc_read_bytes(unsigned int offset, unsigned int length,
-				  u8 *dest)
+static int fwk_ec_lpc_read_bytes(struct fwk_ec_lpc *ec_lpc,
+				 unsigned int offset, unsigned int length,
+				 u8 *dest)
 {
 	u8 sum = 0;
 	int i;
@@ -101,8 +123,9 @@ static int fwk_ec_lpc_read_bytes(unsigned int offset, unsigned int length,
  * A generic instance of the write function of struct lpc_driver_ops, used for
  * the LPC EC.
  */
-static int fwk_ec_lpc_write_bytes(unsigned int offset, unsigned int length,
-				   const u8 *msg)
+static int fwk_ec_lpc_write_bytes(struct fwk_ec_lpc *ec_lpc,
+				  unsigned int offset, unsigned int length,
+				  const u8 *msg)
 {
 	u8 sum = 0;
 	int i;
@@ -120,8 +143,9 @@ static int fwk_ec_lpc_write_bytes(unsigned int offset, unsigned int length,
  * An instance of the read function of struct lpc_driver_ops, used for the
  * MEC variant of LPC EC.
  */
-static int fwk_ec_lpc_mec_read_bytes(unsigned int offset, unsigned int length,
-				      u8 *dest)
+static int fwk_ec_lpc_mec_read_bytes(struct fwk_ec_lpc *ec_lpc,
+				     unsigned int offset, unsigned int length,
+				     u8 *dest)
 {
 	int in_range;
 
@@ -136,16 +160,17 @@ static int fwk_ec_lpc_mec_read_bytes(unsigned int offset, unsigned int length,
 	return in_range ?
 		fwk_ec_lpc_io_bytes_mec(MEC_IO_READ,
 					 offset - EC_HOST_CMD_REGION0,
-					 length, dest) :
-		fwk_ec_lpc_read_bytes(offset, length, dest);
+					 length, dest, &ec_lpc->mec_stats) :
+		fwk_ec_lpc_read_bytes(ec_lpc, offset, length, dest);
 }
 
 /*
  * An instance of the write function of struct lpc_driver_ops, used for the
  * MEC variant of LPC EC.
  */
-static int fwk_ec_lpc_mec_write_bytes(unsigned int offset, unsigned int length,
-				       const u8 *msg)
+static int fwk_ec_lpc_mec_write_bytes(struct fwk_ec_lpc *ec_lpc,
+				      unsigned int offset, unsigned int length,
+				      const u8 *msg)
 {
 	int in_range;
 
@@ -160,11 +185,11 @@ static int fwk_ec_lpc_mec_write_bytes(unsigned int offset, unsigned int length,
 	return in_range ?
 		fwk_ec_lpc_io_bytes_mec(MEC_IO_WRITE,
 					 offset - EC_HOST_CMD_REGION0,
-					 length, (u8 *)msg) :
-		fwk_ec_lpc_write_bytes(offset, length, msg);
+					 length, (u8 *)msg, &ec_lpc->mec_stats) :
+		fwk_ec_lpc_write_bytes(ec_lpc, offset, length, msg);
 }
 
-static int ec_response_timed_out(void)
+static int ec_response_timed_out(struct fwk_ec_lpc *ec_lpc)
 {
 	unsigned long one_second = jiffies + HZ;
 	u8 data;
@@ -172,7 +197,8 @@ static int ec_response_timed_out(void)
 
 	usleep_range(200, 300);
 	do {
-		ret = fwk_ec_lpc_ops.read(EC_LPC_ADDR_HOST_CMD, 1, &data);
+		ret = fwk_ec_lpc_ops.read(ec_lpc, EC_LPC_ADDR_HOST_CMD, 1,
+					  &data);
 		if (ret < 0)
 			return ret;
 		if (!(data & EC_LPC_STATUS_BUSY_MASK))
@@ -186,6 +212,7 @@ static int ec_response_timed_out(void)
 static int fwk_ec_pkt_xfer_lpc(struct fwk_ec_device *ec,
 				struct fwk_ec_command *msg)
 {
+	struct fwk_ec_lpc *ec_lpc = ec->priv;
 	struct ec_host_response response;
 	u8 sum;
 	int ret = 0;
@@ -196,27 +223,29 @@ static int fwk_ec_pkt_xfer_lpc(struct fwk_ec_device *ec,
 		goto done;
 
 	/* Write buffer */
-	ret = fwk_ec_lpc_ops.write(EC_LPC_ADDR_HOST_PACKET, ret, ec->dout);
+	ret = fwk_ec_lpc_ops.write(ec_lpc, EC_LPC_ADDR_HOST_PACKET, ret,
+				   ec->dout);
 	if (ret < 0)
 		goto done;
 
 	/* Here we go */
 	sum = EC_COMMAND_PROTOCOL_3;
-	ret = fwk_ec_lpc_ops.write(EC_LPC_ADDR_HOST_CMD, 1, &sum);
+	ret = fwk_ec_lpc_ops.write(ec_lpc, EC_LPC_ADDR_HOST_CMD, 1, &sum);
 	if (ret < 0)
 		goto done;
 
-	ret = ec_response_timed_out();
+	ret = ec_response_timed_out(ec_lpc);
 	if (ret < 0)
 		goto done;
 	if (ret) {
 		dev_warn(ec->dev, "EC response timed out\n");
+		fwk_ec_stat_inc(&ec_lpc->stats, FWK_EC_LPC_STAT_TIMEOUTS);
 		ret = -EIO;
 		goto done;
 	}
 
 	/* Check result */
-	ret = fwk_ec_lpc_ops.read(EC_LPC_ADDR_HOST_DATA, 1, &sum);
+	ret = fwk_ec_lpc_ops.read(ec_lpc, EC_LPC_ADDR_HOST_DATA, 1, &sum);
 	if (ret < 0)
 		goto done;
 	msg->result = sum;
@@ -226,8 +255,8 @@ static int fwk_ec_pkt_xfer_lpc(struct fwk_ec_device *ec,
 
 	/* Read back response */
 	dout = (u8 *)&response;
-	ret = fwk_ec_lpc_ops.read(EC_LPC_ADDR_HOST_PACKET, sizeof(response),
-				   dout);
+	ret = fwk_ec_lpc_ops.read(ec_lpc, EC_LPC_ADDR_HOST_PACKET,
+				  sizeof(response), dout);
 	if (ret < 0)
 		goto done;
 	sum = ret;
@@ -235,6 +264,8 @@ static int fwk_ec_pkt_xfer_lpc(struct fwk_ec_device *ec,
 	msg->result = response.result;
 
 	if (response.data_len > msg->insize) {
+		fwk_ec_stat_inc(&ec_lpc->stats,
+				FWK_EC_LPC_STAT_OVERSIZE_RESPONSES);
 		dev_err(ec->dev,
 			"packet too long (%d bytes, expected %d)",
 			response.data_len, msg->insize);
@@ -243,15 +274,17 @@ static int fwk_ec_pkt_xfer_lpc(struct fwk_ec_device *ec,
 	}
 
 	/* Read response and process checksum */
-	ret = fwk_ec_lpc_ops.read(EC_LPC_ADDR_HOST_PACKET +
-				   sizeof(response), response.data_len,
-				   msg->data);
+	ret = fwk_ec_lpc_ops.read(ec_lpc, EC_LPC_ADDR_HOST_PACKET +
+				  sizeof(response), response.data_len,
+				  msg->data);
 	if (ret < 0)
 		goto done;
 
 	sum += ret;
 
 	if (sum) {
+		fwk_ec_stat_inc(&ec_lpc->stats,
+				FWK_EC_LPC_STAT_CHECKSUM_ERRORS);
 		dev_err(ec->dev,
 			"bad packet checksum %02x\n",
 			response.checksum);
@@ -268,6 +301,7 @@ done:
 static int fwk_ec_cmd_xfer_lpc(struct fwk_ec_device *ec,
 				struct fwk_ec_command *msg)
 {
+	struct fwk_ec_lpc *ec_lpc = ec->priv;
 	struct ec_lpc_host_args args;
 	u8 sum;
 	int ret = 0;
@@ -289,36 +323,37 @@ static int fwk_ec_cmd_xfer_lpc(struct fwk_ec_device *ec,
 	sum = msg->command + args.flags + args.command_version + args.data_size;
 
 	/* Copy data and update checksum */
-	ret = fwk_ec_lpc_ops.write(EC_LPC_ADDR_HOST_PARAM, msg->outsize,
-				    msg->data);
+	ret = fwk_ec_lpc_ops.write(ec_lpc, EC_LPC_ADDR_HOST_PARAM,
+				   msg->outsize, msg->data);
 	if (ret < 0)
 		goto done;
 	sum += ret;
 
 	/* Finalize checksum and write args */
 	args.checksum = sum;
-	ret = fwk_ec_lpc_ops.write(EC_LPC_ADDR_HOST_ARGS, sizeof(args),
-				    (u8 *)&args);
+	ret = fwk_ec_lpc_ops.write(ec_lpc, EC_LPC_ADDR_HOST_ARGS, sizeof(args),
+				   (u8 *)&args);
 	if (ret < 0)
 		goto done;
 
 	/* Here we go */
 	sum = msg->command;
-	ret = fwk_ec_lpc_ops.write(EC_LPC_ADDR_HOST_CMD, 1, &sum);
+	ret = fwk_ec_lpc_ops.write(ec_lpc, EC_LPC_ADDR_HOST_CMD, 1, &sum);
 	if (ret < 0)
 		goto done;
 
-	ret = ec_response_timed_out();
+	ret = ec_response_timed_out(ec_lpc);
 	if (ret < 0)
 		goto done;
 	if (ret) {
 		dev_warn(ec->dev, "EC response timed out\n");
+		fwk_ec_stat_inc(&ec_lpc->stats, FWK_EC_LPC_STAT_TIMEOUTS);
 		ret = -EIO;
 		goto done;
 	}
 
 	/* Check result */
-	ret = fwk_ec_lpc_ops.read(EC_LPC_ADDR_HOST_DATA, 1, &sum);
+	ret = fwk_ec_lpc_ops.read(ec_lpc, EC_LPC_ADDR_HOST_DATA, 1, &sum);
 	if (ret < 0)
 		goto done;
 	msg->result = sum;
@@ -327,11 +362,14 @@ static int fwk_ec_cmd_xfer_lpc(struct fwk_ec_device *ec,
 		goto done;
 
 	/* Read back args */
-	ret = fwk_ec_lpc_ops.read(EC_LPC_ADDR_HOST_ARGS, sizeof(args), (u8 *)&args);
+	ret = fwk_ec_lpc_ops.read(ec_lpc, EC_LPC_ADDR_HOST_ARGS, sizeof(args),
+				  (u8 *)&args);
 	if (ret < 0)
 		goto done;
 
 	if (args.data_size > msg->insize) {
+		fwk_ec_stat_inc(&ec_lpc->stats,
+				FWK_EC_LPC_STAT_OVERSIZE_RESPONSES);
 		dev_err(ec->dev,
 			"packet too long (%d bytes, expected %d)",
 			args.data_size, msg->insize);
@@ -343,14 +381,16 @@ static int fwk_ec_cmd_xfer_lpc(struct fwk_ec_device *ec,
 	sum = msg->command + args.flags + args.command_version + args.data_size;
 
 	/* Read response and update checksum */
-	ret = fwk_ec_lpc_ops.read(EC_LPC_ADDR_HOST_PARAM, args.data_size,
-				    msg->data);
+	ret = fwk_ec_lpc_ops.read(ec_lpc, EC_LPC_ADDR_HOST_PARAM,
+				  args.data_size, msg->data);
 	if (ret < 0)
 		goto done;
 	sum += ret;
 
 	/* Verify checksum */
 	if (args.checksum != sum) {
+		fwk_ec_stat_inc(&ec_lpc->stats,
+				FWK_EC_LPC_STAT_CHECKSUM_ERRORS);
 		dev_err(ec->dev,
 			"bad packet checksum, expected %02x, got %02x\n",
 			args.checksum, sum);
@@ -379,21 +419,27 @@ static int fwk_ec_lpc_readmem(struct fwk_ec_device *ec, unsigned int offset,
 
 	/* fixed length */
 	if (bytes) {
-		ret = fwk_ec_lpc_ops.read(ec_lpc->mmio_memory_base + offset, bytes, s);
+		ret = fwk_ec_lpc_ops.read(ec_lpc,
+					  ec_lpc->mmio_memory_base + offset,
+					  bytes, s);
 		if (ret < 0)
 			return ret;
+		fwk_ec_stat_add(&ec_lpc->stats, FWK_EC_LPC_STAT_READMEM_BYTES,
+				bytes);
 		return bytes;
 	}
 
 	/* string */
 	for (; i < EC_MEMMAP_SIZE; i++, s++) {
-		ret = fwk_ec_lpc_ops.read(ec_lpc->mmio_memory_base + i, 1, s);
+		ret = fwk_ec_lpc_ops.read(ec_lpc, ec_lpc->mmio_memory_base + i,
+					  1, s);
 		if (ret < 0)
 			return ret;
 		cnt++;
 		if (!*s)
 			break;
 	}
+	fwk_ec_stat_add(&ec_lpc->stats, FWK_EC_LPC_STAT_READMEM_BYTES, cnt);
 
 	return cnt;
 }
@@ -402,8 +448,6 @@ static void fwk_ec_lpc_acpi_notify(acpi_handle device, u32 value, void *data)
 {
 	static const char *env[] = { "ERROR=PANIC", NULL };
 	struct fwk_ec_device *ec_dev = data;
-	bool ec_has_more_events;
-	int ret;
 
 	ec_dev->last_event_time = fwk_ec_get_time_ns();
 
@@ -417,15 +461,12 @@ static void fwk_ec_lpc_acpi_notify(acpi_handle device, u32 value, void *data)
 		return;
 	}
 
-	if (ec_dev->mkbp_event_supported)
-		do {
-			ret = fwk_ec_get_next_event(ec_dev, NULL,
-						     &ec_has_more_events);
-			if (ret > 0)
-				blocking_notifier_call_chain(
-						&ec_dev->event_notifier, 0,
-						ec_dev);
-		} while (ec_has_more_events);
+	/*
+	 * Draining the EC can take a while, don't hold up the other ACPI
+	 * notifications meanwhile.
+	 */
+	if (ec_dev->mkbp_event_supported || ec_dev->host_event_memmap)
+		fwk_ec_queue_event_work(ec_dev);
 
 	if (value == ACPI_NOTIFY_DEVICE_WAKE)
 		pm_system_wakeup();
@@ -448,6 +489,18 @@ static int fwk_ec_lpc_probe(struct platform_device *pdev)
 
 	ec_lpc->mmio_memory_base = EC_LPC_ADDR_MEMMAP;
 
+	ec_lpc->stats.name = "lpc";
+	ec_lpc->stats.names = fwk_ec_lpc_stat_names;
+	ec_lpc->stats.count = FWK_EC_LPC_STATS;
+	ret = devm_fwk_ec_stats_group_init(dev, &ec_lpc->stats);
+	if (ret)
+		return ret;
+
+	fwk_ec_lpc_mec_stats_init(&ec_lpc->mec_stats);
+	ret = devm_fwk_ec_stats_group_init(dev, &ec_lpc->mec_stats);
+	if (ret)
+		return ret;
+
 	adev = ACPI_COMPANION(dev);
 
 	if (fwk_ec_lpc_driver_data) {
@@ -496,7 +549,7 @@ static int fwk_ec_lpc_probe(struct platform_device *pdev)
 	 */
 	fwk_ec_lpc_ops.read = fwk_ec_lpc_mec_read_bytes;
 	fwk_ec_lpc_ops.write = fwk_ec_lpc_mec_write_bytes;
-	fwk_ec_lpc_ops.read(EC_LPC_ADDR_MEMMAP + EC_MEMMAP_ID, 2, buf);
+	fwk_ec_lpc_ops.read(ec_lpc, EC_LPC_ADDR_MEMMAP + EC_MEMMAP_ID, 2, buf);
 	if (buf[0] != 'E' || buf[1] != 'C') {
 		if (!devm_request_region(dev, ec_lpc->mmio_memory_base, EC_MEMMAP_SIZE,
 					 dev_name(dev))) {
@@ -507,8 +560,9 @@ static int fwk_ec_lpc_probe(struct platform_device *pdev)
 		/* Re-assign read/write operations for the non MEC variant */
 		fwk_ec_lpc_ops.read = fwk_ec_lpc_read_bytes;
 		fwk_ec_lpc_ops.write = fwk_ec_lpc_write_bytes;
-		fwk_ec_lpc_ops.read(ec_lpc->mmio_memory_base + EC_MEMMAP_ID, 2,
-				     buf);
+		fwk_ec_lpc_ops.read(ec_lpc,
+				    ec_lpc->mmio_memory_base + EC_MEMMAP_ID,
+				    2, buf);
 		if (buf[0] != 'E' || buf[1] != 'C') {
 			dev_err(dev, "EC ID not detected\n");
 			return -ENODEV;
@@ -561,6 +615,10 @@ static int fwk_ec_lpc_probe(struct platform_device *pdev)
 		return ret;
 	}
 
+	fwk_ec_stats_register(ec_dev, &ec_lpc->stats);
+	if (fwk_ec_lpc_ops.read == fwk_ec_lpc_mec_read_bytes)
+		fwk_ec_stats_register(ec_dev, &ec_lpc->mec_stats);
+
 	/*
 	 * Connect a notify handler to process MKBP messages if we have a
 	 * companion ACPI device.
@@ -581,6 +639,7 @@ static int fwk_ec_lpc_probe(struct platform_device *pdev)
 static void fwk_ec_lpc_remove(struct platform_device *pdev)
 {
 	struct fwk_ec_device *ec_dev = platform_get_drvdata(pdev);
+	struct fwk_ec_lpc *ec_lpc = ec_dev->priv;
 	struct acpi_device *adev;
 
 	adev = ACPI_COMPANION(&pdev->dev);
@@ -588,6 +647,9 @@ static void fwk_ec_lpc_remove(struct platform_device *pdev)
 		acpi_remove_notify_handler(adev->handle, ACPI_ALL_NOTIFY,
 					   fwk_ec_lpc_acpi_notify);
 
+	fwk_ec_stats_unregister(ec_dev, &ec_lpc->mec_stats);
+	fwk_ec_stats_unregister(ec_dev, &ec_lpc->stats);
+
 	fwk_ec_unregister(ec_dev);
 }
 
@@ -22,6 +22,12 @@ static acpi_handle aml_mutex;
 
 static int n_debug;
 
+static const char * const fwk_ec_lpc_mec_stat_names[FWK_EC_LPC_MEC_STATS] = {
+	[FWK_EC_LPC_MEC_STAT_TRANSFERS] = "transfers",
+	[FWK_EC_LPC_MEC_STAT_BYTES] = "bytes",
+	[FWK_EC_LPC_MEC_STAT_LOCK_ERRORS] = "lock_errors",
+};
+
 static int fwk_ec_lpc_mec_lock(void)
 {
 	bool success;
@@ -115,12 +121,13 @@ int fwk_ec_lpc_mec_in_range(unsigned int offset, unsigned int length)
  * @offset:  Base read / write address
  * @length:  Number of bytes to read / write
  * @buf:     Destination / source buffer
+ * @stats:   Counters of the EC the transfer is for
  *
  * Return: 8-bit checksum of all bytes read / written
  */
 int fwk_ec_lpc_io_bytes_mec(enum fwk_ec_lpc_mec_io_type io_type,
 			     unsigned int offset, unsigned int length,
-			     u8 *buf)
+			     u8 *buf, struct fwk_ec_stats_group *stats)
 {
 	int i = 0;
 	int io_addr;
@@ -143,8 +150,13 @@ int fwk_ec_lpc_io_bytes_mec(enum fwk_ec_lpc_mec_io_type io_type,
 		access = ACCESS_TYPE_LONG_AUTO_INCREMENT;
 
 	ret = fwk_ec_lpc_mec_lock();
-	if (ret)
+	if (ret) {
+		fwk_ec_stat_inc(stats, FWK_EC_LPC_MEC_STAT_LOCK_ERRORS);
 		return ret;
+	}
+
+	fwk_ec_stat_inc(stats, FWK_EC_LPC_MEC_STAT_TRANSFERS);
+	fwk_ec_stat_add(stats, FWK_EC_LPC_MEC_STAT_BYTES, length);
 
 	/* Initialize I/O at desired address */
 	fwk_ec_lpc_mec_emi_write_address(offset, access);
@@ -199,6 +211,14 @@ void fwk_ec_lpc_mec_init(unsigned int base, unsigned int end)
 }
 EXPORT_SYMBOL(fwk_ec_lpc_mec_init);
 
+void fwk_ec_lpc_mec_stats_init(struct fwk_ec_stats_group *stats)
+{
+	stats->name = "mec";
+	stats->names = fwk_ec_lpc_mec_stat_names;
+	stats->count = FWK_EC_LPC_MEC_STATS;
+}
+EXPORT_SYMBOL(fwk_ec_lpc_mec_stats_init);
+
 int fwk_ec_lpc_mec_mutex(struct acpi_device *adev,
 			  const char *aml_mutex_name)
 {
@@ -10,6 +10,8 @@
 
 #include <linux/acpi.h>
 
+#include <fwk_ec_stats.h>
+
 enum fwk_ec_lpc_mec_emi_access_mode {
 	/* 8-bit access */
 	ACCESS_TYPE_BYTE = 0x0,
@@ -29,6 +31,13 @@ enum fwk_ec_lpc_mec_io_type {
 	MEC_IO_WRITE,
 };
 
+enum fwk_ec_lpc_mec_stat {
+	FWK_EC_LPC_MEC_STAT_TRANSFERS,
+	FWK_EC_LPC_MEC_STAT_BYTES,
+	FWK_EC_LPC_MEC_STAT_LOCK_ERRORS,
+	FWK_EC_LPC_MEC_STATS,
+};
+
 /* EMI registers are relative to base */
 #define MEC_EMI_HOST_TO_EC(MEC_EMI_BASE)	((MEC_EMI_BASE) + 0)
 #define MEC_EMI_EC_TO_HOST(MEC_EMI_BASE)	((MEC_EMI_BASE) + 1)
@@ -47,6 +56,13 @@ enum fwk_ec_lpc_mec_io_type {
  */
 void fwk_ec_lpc_mec_init(unsigned int base, unsigned int end);
 
+/**
+ * fwk_ec_lpc_mec_stats_init() - Describe the EMI counters of an EC.
+ *
+ * @stats: Group to fill in, see enum fwk_ec_lpc_mec_stat
+ */
+void fwk_ec_lpc_mec_stats_init(struct fwk_ec_stats_group *stats);
+
 int fwk_ec_lpc_mec_mutex(struct acpi_device *adev,
 			  const char *aml_mutex_name);
 
@@ -68,10 +84,13 @@ int fwk_ec_lpc_mec_in_range(unsigned int offset, unsigned int length);
  * @offset:  Base read / write address
  * @length:  Number of bytes to read / write
  * @buf:     Destination / source buffer
+ * @stats:   Counters of the EC the transfer is for, see
+ *           enum fwk_ec_lpc_mec_stat
  *
  * @return: a negative error code on error, or the 8-bit checksum
  */
 int fwk_ec_lpc_io_bytes_mec(enum fwk_ec_lpc_mec_io_type io_type,
-			     unsigned int offset, unsigned int length, u8 *buf);
+			     unsigned int offset, unsigned int length, u8 *buf,
+			     struct fwk_ec_stats_group *stats);
 
 #endif /* __FWK_EC_LPC_MEC_H */
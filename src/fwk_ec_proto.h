@@ -9,11 +9,16 @@
 #define __LINUX_FWK_EC_PROTO_H
 
 #include <linux/device.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
 #include <linux/lockdep_types.h>
 #include <linux/mutex.h>
 #include <linux/notifier.h>
+#include <linux/rwsem.h>
+#include <linux/spinlock.h>
 
 #include <fwk_ec_commands.h>
+#include <fwk_ec_stats.h>
 
 #define FWK_EC_DEV_NAME	"cros_ec"
 #define FWK_EC_DEV_FP_NAME	"fwk_fp"
@@ -83,6 +88,334 @@ struct fwk_ec_command {
 	uint8_t data[];
 };
 
+/* Number of events kept in the per-device event ring. Must be a power of 2. */
+#define FWK_EC_EVENT_RING_SIZE		256
+
+/**
+ * struct fwk_ec_event - An MKBP event as recorded in the device event ring.
+ * @seq: Per-device sequence number of the event, starting at 1.
+ * @irq_time: Time the EC notified us of the event (see last_event_time).
+ * @fetch_time: Time the event was retrieved from the EC.
+ * @queue_time: Time the event was recorded in the ring.
+ * @size: Size in bytes of the event payload in @data.data.
+ * @data: Event type (without EC_MKBP_HAS_MORE_EVENTS) and raw payload.
+ */
+struct fwk_ec_event {
+	u64 seq;
+	ktime_t irq_time;
+	ktime_t fetch_time;
+	ktime_t queue_time;
+	int size;
+	struct ec_response_get_next_event_v1 data;
+};
+
+/**
+ * struct fwk_ec_event_ring - Fixed-size ring of the most recent MKBP events.
+ * @lock: Protects the ring.
+ * @events: Ring storage of FWK_EC_EVENT_RING_SIZE entries.
+ * @head: Sequence number the next event will be recorded with.
+ * @overruns: Total number of events consumers missed because they fell
+ *            more than FWK_EC_EVENT_RING_SIZE events behind.
+ *
+ * The ring is filled from the event path (interrupt thread or ACPI notify)
+ * and never blocks on its consumers: old entries are simply overwritten.
+ * Each consumer keeps its own struct fwk_ec_event_cursor.
+ */
+struct fwk_ec_event_ring {
+	spinlock_t lock;
+	struct fwk_ec_event *events;
+	u64 head;
+	u64 overruns;
+};
+
+/**
+ * struct fwk_ec_event_cursor - Read position of an event ring consumer.
+ * @seq: Sequence number of the next event to read.
+ * @lost: Number of events this consumer missed because it fell behind.
+ */
+struct fwk_ec_event_cursor {
+	u64 seq;
+	u64 lost;
+};
+
+struct fwk_ec_event_subscriber;
+
+/*
+ * Default interrupt mitigation settings. The IRQ is masked and the EC polled
+ * once more than FWK_EC_IRQ_POLL_THRESHOLD events per second come in.
+ */
+#define FWK_EC_IRQ_POLL_THRESHOLD	1000
+#define FWK_EC_IRQ_POLL_BUDGET		32
+#define FWK_EC_IRQ_POLL_INTERVAL_US	1000
+
+/* Bounds of the settings, polling must neither spin nor starve the EC. */
+#define FWK_EC_IRQ_POLL_BUDGET_MAX		1024
+#define FWK_EC_IRQ_POLL_INTERVAL_MIN_US		100
+#define FWK_EC_IRQ_POLL_INTERVAL_MAX_US		USEC_PER_SEC
+
+/**
+ * struct fwk_ec_irq_poll - Interrupt mitigation state of an EC device.
+ * @threshold: Event rate, in events per second, above which the interrupt
+ *             is masked and the EC is polled instead. Zero disables polling.
+ * @budget: Maximum number of events handled per poll, from 1 to
+ *          FWK_EC_IRQ_POLL_BUDGET_MAX.
+ * @interval_us: Delay between two polls, in microseconds, from
+ *               FWK_EC_IRQ_POLL_INTERVAL_MIN_US to
+ *               FWK_EC_IRQ_POLL_INTERVAL_MAX_US.
+ * @enter_count: Number of switches from interrupt to polled mode.
+ * @exit_count: Number of switches from polled back to interrupt mode.
+ * @active: True while the interrupt is masked and the EC is polled.
+ * @window_start: Start of the current event rate measurement window.
+ * @window_events: Number of events handled in the current window.
+ * @lock: Serializes mode switches.
+ * @timer: Fires when the next poll is due.
+ * @work: Polls the EC, runs on the event worker.
+ */
+struct fwk_ec_irq_poll {
+	u32 threshold;
+	u32 budget;
+	u32 interval_us;
+	u64 enter_count;
+	u64 exit_count;
+	bool active;
+	ktime_t window_start;
+	u32 window_events;
+	struct mutex lock;
+	struct hrtimer timer;
+	struct kthread_work work;
+};
+
+/**
+ * struct fwk_ec_event_link - Entry of a subscriber in the dispatch table.
+ * @node: Links into one of the fwk_ec_device event_subscribers[] lists.
+ * @sub: The subscriber this entry belongs to.
+ */
+struct fwk_ec_event_link {
+	struct list_head node;
+	struct fwk_ec_event_subscriber *sub;
+};
+
+/**
+ * struct fwk_ec_event_subscriber - Subscriber to a subset of MKBP events.
+ * @nb: Called as nb->notifier_call(nb, queued_during_suspend, ec_dev) for
+ *      every matching event, just like the members of the event_notifier
+ *      chain.
+ * @event_types: Bitmap of BIT(EC_MKBP_EVENT_*) types to be notified of.
+ * @host_event_mask: If non-zero, EC_MKBP_EVENT_HOST_EVENT and
+ *                   EC_MKBP_EVENT_HOST_EVENT64 events are only delivered
+ *                   when at least one of these EC_HOST_EVENT_MASK() bits is
+ *                   set.
+ * @links: Dispatch table entries, one per event type.
+ */
+struct fwk_ec_event_subscriber {
+	struct notifier_block nb;
+	unsigned long event_types;
+	u64 host_event_mask;
+	struct fwk_ec_event_link links[EC_MKBP_EVENT_COUNT];
+};
+
+#define FWK_EC_SLEEP_HISTORY_SIZE	64
+
+/**
+ * struct fwk_ec_sleep_record - Timings of one suspend/resume cycle.
+ * @start: Boot time, in nanoseconds, the cycle started at.
+ * @sleep_event: HOST_SLEEP_EVENT_* sent to enter suspend.
+ * @suspend_ret: Result of the suspend sleep event command.
+ * @resume_ret: Result of the resume sleep event command.
+ * @suspend_event_ns: Duration of the suspend sleep event command.
+ * @irq_disable_ns: Duration of the suspend_late stage.
+ * @replay_ns: Duration of the replay of the events queued during suspend.
+ * @replay_events: Number of events replayed.
+ * @resume_event_ns: Duration of the resume sleep event command.
+ * @sleep_transitions: Number of sleep power signal transitions the EC saw,
+ *                     when reported.
+ * @timeout: True if the EC reported a sleep transition timeout.
+ */
+struct fwk_ec_sleep_record {
+	u64 start;
+	u8 sleep_event;
+	int suspend_ret;
+	int resume_ret;
+	u64 suspend_event_ns;
+	u64 irq_disable_ns;
+	u64 replay_ns;
+	u32 replay_events;
+	u64 resume_event_ns;
+	u16 sleep_transitions;
+	bool timeout;
+};
+
+/**
+ * struct fwk_ec_sleep_history - Ring of the latest suspend/resume cycles.
+ * @lock: Protects the history.
+ * @count: Number of cycles recorded so far. The current one is
+ *         records[(count - 1) % FWK_EC_SLEEP_HISTORY_SIZE].
+ * @replay_cycle: Value of @count when the pending event replay was queued.
+ * @records: The records.
+ */
+struct fwk_ec_sleep_history {
+	struct mutex lock;
+	u64 count;
+	u64 replay_cycle;
+	struct fwk_ec_sleep_record records[FWK_EC_SLEEP_HISTORY_SIZE];
+};
+
+/**
+ * struct fwk_ec_wake_stats - Wake source attribution, per host event.
+ * @lock: Protects the statistics.
+ * @seen: Number of times each host event was raised. Host event n, as in
+ *        EC_HOST_EVENT_MASK(n), is accounted at index n - 1.
+ * @wakes: Number of times each host event was flagged as a wake event.
+ * @suppressed: Number of times each host event was raised without being
+ *              flagged as a wake event: RTC events, which the RTC driver
+ *              reports itself, and events outside host_event_wake_mask.
+ * @last_wake: Boot time, in nanoseconds, of the latest wake event.
+ */
+struct fwk_ec_wake_stats {
+	spinlock_t lock;
+	u64 seen[64];
+	u64 wakes[64];
+	u64 suppressed[64];
+	u64 last_wake;
+};
+
+/*
+ * Host event masks cached by the host event mask manager: SCI, SMI, active
+ * wake, and the lazy wake masks the EC applies when entering S0ix and S3.
+ */
+#define FWK_EC_HOST_EVENT_MASKS		5
+
+/**
+ * struct fwk_ec_host_event_mask - Cached host event mask.
+ * @base: Value found in the EC when the cache was first filled, i.e. what
+ *        the firmware programmed. Always kept in the mask.
+ * @requested: Host events with a non-zero reference count in @refs.
+ * @value: Value currently programmed in the EC.
+ * @refs: Reference count of each host event, host event n at index n - 1.
+ * @valid: True once @base and @value were read from the EC.
+ */
+struct fwk_ec_host_event_mask {
+	u64 base;
+	u64 requested;
+	u64 value;
+	u32 refs[64];
+	bool valid;
+};
+
+/**
+ * struct fwk_ec_host_event_masks - Host event mask manager.
+ * @lock: Protects the masks. Nests outside of the fwk_ec_device lock.
+ * @unified: True if the EC implements EC_CMD_HOST_EVENT, false if only the
+ *           legacy 32-bit EC_CMD_HOST_EVENT_{GET,SET}_*_MASK commands are
+ *           available.
+ * @masks: The cached masks, see fwk_ec_host_event_mask_get().
+ */
+struct fwk_ec_host_event_masks {
+	struct mutex lock;
+	bool unified;
+	struct fwk_ec_host_event_mask masks[FWK_EC_HOST_EVENT_MASKS];
+};
+
+/**
+ * struct fwk_ec_latency - Latency statistics, in nanoseconds.
+ * @count: Number of samples.
+ * @last_ns: Latest sample.
+ * @min_ns: Smallest sample.
+ * @max_ns: Largest sample.
+ * @total_ns: Sum of all samples.
+ */
+struct fwk_ec_latency {
+	u64 count;
+	u64 last_ns;
+	u64 min_ns;
+	u64 max_ns;
+	u64 total_ns;
+};
+
+/* Command targets: the EC itself, then the devices behind it. */
+#define FWK_EC_BUS_TARGETS		4
+/* Bus time, in microseconds, given to each busy target per round. */
+#define FWK_EC_BUS_QUANTUM_US		2000
+/* Most commands of a batch sent without handing the bus over. */
+#define FWK_EC_BUS_BATCH_MAX		8
+
+/**
+ * enum fwk_ec_bus_class - Who a command is sent on behalf of.
+ * @FWK_EC_BUS_CLASS_KERNEL: In-kernel drivers, the default.
+ * @FWK_EC_BUS_CLASS_EVENT: Event fetching, on the event delivery path.
+ * @FWK_EC_BUS_CLASS_USER: Userspace, through the character device.
+ * @FWK_EC_BUS_CLASSES: Number of classes.
+ */
+enum fwk_ec_bus_class {
+	FWK_EC_BUS_CLASS_KERNEL,
+	FWK_EC_BUS_CLASS_EVENT,
+	FWK_EC_BUS_CLASS_USER,
+	FWK_EC_BUS_CLASSES,
+};
+
+/*
+ * Wait time histogram buckets: bucket 0 counts waits under 1us, bucket n
+ * waits in [2^(n-1), 2^n) us, and the last one everything longer.
+ */
+#define FWK_EC_BUS_HIST_BUCKETS		24
+
+/**
+ * struct fwk_ec_bus_class_stats - Bus wait statistics of a caller class.
+ * @wait: Time commands waited for the bus.
+ * @hist: Log2 histogram of @wait, see FWK_EC_BUS_HIST_BUCKETS.
+ */
+struct fwk_ec_bus_class_stats {
+	struct fwk_ec_latency wait;
+	u64 hist[FWK_EC_BUS_HIST_BUCKETS];
+};
+
+/**
+ * struct fwk_ec_bus_target - Per-target state of the bus arbiter.
+ * @waiters: Commands waiting for the bus, in arrival order.
+ * @deficit_ns: Bus time the target may still use in the current round.
+ *              Commands are charged once done, so it can go negative.
+ * @wait: Time commands waited for the bus.
+ * @service: Time commands held the bus.
+ */
+struct fwk_ec_bus_target {
+	struct list_head waiters;
+	s64 deficit_ns;
+	struct fwk_ec_latency wait;
+	struct fwk_ec_latency service;
+};
+
+/**
+ * struct fwk_ec_bus - Arbiter of the commands sent to the EC.
+ * @lock: Protects the arbiter.
+ * @busy: True while a command owns the bus.
+ * @owner: Target of the command owning, or which last owned, the bus.
+ * @quantum_us: Bus time, in microseconds, each target with waiting
+ *              commands is given per deficit round robin round.
+ * @fifo: Serve all commands in strict ticket order instead, whatever
+ *        their target. A command then never waits for more commands than
+ *        there were queued before it.
+ * @next_ticket: Ticket of the next command to queue.
+ * @targets: Per-target state, indexed by EC_CMD_PASSTHRU_OFFSET() index.
+ * @classes: Per-caller class statistics.
+ *
+ * Commands for the EC and for the devices behind it (PD, ...) all go
+ * through the same transport. Each target gets its own queue, and queues
+ * are served with deficit round robin on the bus time they use, so a slow
+ * target cannot starve the others. The bus is always handed over from a
+ * command to the next one: a caller looping on commands cannot take it
+ * again ahead of the ones already waiting.
+ */
+struct fwk_ec_bus {
+	spinlock_t lock;
+	bool busy;
+	unsigned int owner;
+	u32 quantum_us;
+	bool fifo;
+	u64 next_ticket;
+	struct fwk_ec_bus_target targets[FWK_EC_BUS_TARGETS];
+	struct fwk_ec_bus_class_stats classes[FWK_EC_BUS_CLASSES];
+};
+
 /**
  * struct fwk_ec_device - Information about a ChromeOS EC device.
  * @phys_name: Name of physical comms layer (e.g. 'i2c-4').
@@ -126,14 +459,28 @@ struct fwk_ec_command {
  * @lockdep_key: Lockdep class for each instance. Unused if CONFIG_LOCKDEP is
  *		 not enabled.
  * @lock: One transaction at a time.
+ * @bus: Arbitrates between the commands waiting for @lock.
  * @mkbp_event_supported: 0 if MKBP not supported. Otherwise its value is
  *                        the maximum supported version of the MKBP host event
  *                        command + 1.
  * @host_sleep_v1: True if this EC supports the sleep v1 command.
+ * @host_event_memmap: True if the EC mirrors its raw host events at
+ *                     EC_MEMMAP_HOST_EVENTS, in a layout we understand.
+ * @host_event_snapshot: Raw host events last read from the memory map,
+ *                       less the ones acknowledged since.
  * @event_notifier: Interrupt event notifier for transport devices.
+ * @event_subscribers_rwsem: Protects @event_subscribers.
+ * @event_subscribers: Dispatch table of struct fwk_ec_event_subscriber,
+ *                     indexed by MKBP event type.
  * @event_data: Raw payload transferred with the MKBP event.
  * @event_size: Size in bytes of the event data.
+ * @event_seq: Sequence number @event_data was recorded with in @event_ring.
+ * @event_irq_time: Time the EC notified us of @event_data.
+ * @event_fetch_time: Time @event_data was retrieved from the EC.
+ * @event_ring: Timestamped history of the events fetched from the EC.
  * @host_event_wake_mask: Mask of host events that cause wake from suspend.
+ * @host_event_masks: Cached SCI, SMI and wake masks of the EC.
+ * @wake_stats: Which host events woke us, or were kept from doing so.
  * @suspend_timeout_ms: The timeout in milliseconds between when sleep event
  *                      is received and when the EC will declare sleep
  *                      transition failure if the sleep signal is not
@@ -143,9 +490,21 @@ struct fwk_ec_command {
  *                      occurred since the suspend message. The high bit
  *                      indicates a timeout occurred.  See also struct
  *                      ec_response_host_sleep_event_v1 in fwk_ec_commands.h.
+ * @sleep_history: Timings of the latest suspend/resume cycles.
  * @last_event_time: exact time from the hard irq when we got notified of
  *     a new event.
- * @notifier_ready: The notifier_block to let the kernel re-query EC
+ * @event_worker: Real-time worker draining events outside of the
+ *                interrupt and ACPI notify contexts.
+ * @event_work: Drains pending events, see fwk_ec_queue_event_work().
+ * @resume_work: Replays the events queued during suspend, then unmasks the
+ *               interrupt.
+ * @resume_event_work: Sends the resume sleep event, queued after
+ *                     @resume_work.
+ * @event_latency: Delay between @last_event_time and the dispatch of the
+ *                 first event drained by @event_work.
+ * @irq_poll: Interrupt mitigation state, see struct fwk_ec_irq_poll.
+ * @stats: Counters of the drivers of this device, see struct fwk_ec_stats.
+ * @notifier_ready: The event subscriber to let the kernel re-query EC
  *		    communication protocol when the EC sends
  *		    EC_HOST_EVENT_INTERFACE_READY.
  * @ec: The platform_device used by the mfd driver to interface with the
@@ -181,17 +540,36 @@ struct fwk_ec_device {
 			struct fwk_ec_command *msg);
 	struct lock_class_key lockdep_key;
 	struct mutex lock;
+	struct fwk_ec_bus bus;
 	u8 mkbp_event_supported;
 	bool host_sleep_v1;
+	bool host_event_memmap;
+	u64 host_event_snapshot;
 	struct blocking_notifier_head event_notifier;
+	struct rw_semaphore event_subscribers_rwsem;
+	struct list_head event_subscribers[EC_MKBP_EVENT_COUNT];
 
 	struct ec_response_get_next_event_v1 event_data;
 	int event_size;
-	u32 host_event_wake_mask;
+	u64 event_seq;
+	ktime_t event_irq_time;
+	ktime_t event_fetch_time;
+	struct fwk_ec_event_ring event_ring;
+	u64 host_event_wake_mask;
+	struct fwk_ec_host_event_masks host_event_masks;
+	struct fwk_ec_wake_stats wake_stats;
 	u32 last_resume_result;
 	u16 suspend_timeout_ms;
+	struct fwk_ec_sleep_history sleep_history;
 	ktime_t last_event_time;
-	struct notifier_block notifier_ready;
+	struct kthread_worker *event_worker;
+	struct kthread_work event_work;
+	struct kthread_work resume_work;
+	struct kthread_work resume_event_work;
+	struct fwk_ec_latency event_latency;
+	struct fwk_ec_irq_poll irq_poll;
+	struct fwk_ec_stats stats;
+	struct fwk_ec_event_subscriber notifier_ready;
 
 	/* The platform devices used by the mfd driver */
 	struct platform_device *ec;
@@ -220,6 +598,8 @@ struct fwk_ec_platform {
  * @debug_info: fwk_ec_debugfs structure for debugging information.
  * @has_kb_wake_angle: True if at least 2 accelerometer are connected to the EC.
  * @cmd_offset: Offset to apply for each command.
+ * @features_lock: Serializes the first read of @features.
+ * @features_read: True once @features was read from the EC.
  * @features: Features supported by the EC.
  */
 struct fwk_ec_dev {
@@ -229,6 +609,8 @@ struct fwk_ec_dev {
 	struct fwk_ec_debugfs *debug_info;
 	bool has_kb_wake_angle;
 	u16 cmd_offset;
+	struct mutex features_lock;
+	bool features_read;
 	struct ec_response_get_features features;
 };
 
@@ -243,6 +625,14 @@ int fwk_ec_check_result(struct fwk_ec_device *ec_dev,
 int fwk_ec_cmd_xfer(struct fwk_ec_device *ec_dev,
 		     struct fwk_ec_command *msg);
 
+int fwk_ec_cmd_xfer_class(struct fwk_ec_device *ec_dev,
+			  struct fwk_ec_command *msg,
+			  enum fwk_ec_bus_class cls);
+
+void fwk_ec_cmd_xfer_batch(struct fwk_ec_device *ec_dev,
+			   struct fwk_ec_command **msgs, int *rets,
+			   unsigned int count, enum fwk_ec_bus_class cls);
+
 int fwk_ec_cmd_xfer_status(struct fwk_ec_device *ec_dev,
 			    struct fwk_ec_command *msg);
 
@@ -254,6 +644,49 @@ int fwk_ec_get_next_event(struct fwk_ec_device *ec_dev,
 
 u32 fwk_ec_get_host_event(struct fwk_ec_device *ec_dev);
 
+u64 fwk_ec_get_host_event64(struct fwk_ec_device *ec_dev);
+
+void fwk_ec_event_cursor_init(struct fwk_ec_device *ec_dev,
+			       struct fwk_ec_event_cursor *cursor);
+
+int fwk_ec_event_ring_read(struct fwk_ec_device *ec_dev,
+			    struct fwk_ec_event_cursor *cursor,
+			    struct fwk_ec_event *event);
+
+bool fwk_ec_event_ring_pending(struct fwk_ec_device *ec_dev,
+			       const struct fwk_ec_event_cursor *cursor);
+
+int fwk_ec_register_event_subscriber(struct fwk_ec_device *ec_dev,
+				      struct fwk_ec_event_subscriber *sub);
+
+void fwk_ec_update_event_subscriber(struct fwk_ec_device *ec_dev,
+				     struct fwk_ec_event_subscriber *sub,
+				     unsigned long event_types,
+				     u64 host_event_mask);
+
+void fwk_ec_unregister_event_subscriber(struct fwk_ec_device *ec_dev,
+					 struct fwk_ec_event_subscriber *sub);
+
+void fwk_ec_latency_record(struct fwk_ec_latency *lat, u64 ns);
+
+int fwk_ec_host_event_masks_sync(struct fwk_ec_device *ec_dev);
+
+int fwk_ec_host_event_mask_get(struct fwk_ec_device *ec_dev, u8 mask_type,
+			       u64 events);
+
+void fwk_ec_host_event_mask_put(struct fwk_ec_device *ec_dev, u8 mask_type,
+				u64 events);
+
+int fwk_ec_host_event_masks_prepare_sleep(struct fwk_ec_device *ec_dev,
+					  u8 sleep_event);
+
+bool fwk_ec_host_event_match(u8 event_type, int size,
+			     const union ec_response_get_next_data_v1 *data,
+			     u64 host_event_mask);
+
+void fwk_ec_notify_event(struct fwk_ec_device *ec_dev,
+			  unsigned long queued_during_suspend);
+
 bool fwk_ec_check_features(struct fwk_ec_dev *ec, int feature);
 
 int fwk_ec_get_sensor_count(struct fwk_ec_dev *ec);
@@ -3,8 +3,10 @@
 //
 // Copyright (C) 2015 Google, Inc
 
+#include <linux/completion.h>
 #include <linux/delay.h>
 #include <linux/device.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <fwk_ec_commands.h>
 #include <fwk_ec_proto.h>
@@ -15,6 +17,14 @@
 
 #define EC_COMMAND_RETRIES	50
 
+/* Layout version of EC_MEMMAP_HOST_EVENTS this driver understands */
+#define EC_MEMMAP_EVENTS_VERSION_1	1
+
+static bool host_event_memmap;
+module_param(host_event_memmap, bool, 0444);
+MODULE_PARM_DESC(host_event_memmap,
+		 "Read host events from the memory map on ECs without MKBP");
+
 static const int fwk_ec_error_map[] = {
 	[EC_RES_INVALID_COMMAND] = -EOPNOTSUPP,
 	[EC_RES_ERROR] = -EIO,
@@ -131,6 +141,22 @@ static int fwk_ec_xfer_command(struct fwk_ec_device *ec_dev, struct fwk_ec_comma
 	ret = (*xfer_fxn)(ec_dev, msg);
 	trace_fwk_ec_request_done(msg, ret);
 
+	fwk_ec_stat_inc(&ec_dev->stats.proto, FWK_EC_STAT_COMMANDS);
+	fwk_ec_stat_add(&ec_dev->stats.proto, FWK_EC_STAT_BYTES_OUT,
+			msg->outsize);
+	if (ret < 0) {
+		fwk_ec_stat_inc(&ec_dev->stats.proto, FWK_EC_STAT_XFER_ERRORS);
+		if (ret == -ETIMEDOUT)
+			fwk_ec_stat_inc(&ec_dev->stats.proto,
+					FWK_EC_STAT_TIMEOUTS);
+	} else {
+		fwk_ec_stat_add(&ec_dev->stats.proto, FWK_EC_STAT_BYTES_IN,
+				ret);
+		fwk_ec_stat_inc(&ec_dev->stats.proto, FWK_EC_STAT_RESULT +
+				min_t(u32, msg->result,
+				      FWK_EC_STAT_RESULTS - 1));
+	}
+
 	return ret;
 }
 
@@ -152,6 +178,7 @@ static int fwk_ec_wait_until_complete(struct fwk_ec_device *ec_dev, uint32_t *re
 	/* Query the EC's status until it's no longer busy or we encounter an error. */
 	for (i = 0; i < EC_COMMAND_RETRIES; ++i) {
 		usleep_range(10000, 11000);
+		fwk_ec_stat_inc(&ec_dev->stats.proto, FWK_EC_STAT_RETRIES);
 
 		ret = fwk_ec_xfer_command(ec_dev, msg);
 		if (ret == -EAGAIN)
@@ -172,8 +199,10 @@ static int fwk_ec_wait_until_complete(struct fwk_ec_device *ec_dev, uint32_t *re
 			return ret;
 	}
 
-	if (i >= EC_COMMAND_RETRIES)
+	if (i >= EC_COMMAND_RETRIES) {
+		fwk_ec_stat_inc(&ec_dev->stats.proto, FWK_EC_STAT_TIMEOUTS);
 		ret = -EAGAIN;
+	}
 
 	return ret;
 }
@@ -244,27 +273,48 @@ EXPORT_SYMBOL(fwk_ec_check_result);
  *
  * Get the mask of host events that cause wake from suspend.
  *
+ * EC_CMD_HOST_EVENT reports all 64 host events and is tried first. Older ECs
+ * only implement EC_CMD_HOST_EVENT_GET_WAKE_MASK, limited to 32 events.
+ *
  * @ec_dev: EC device to call
- * @msg: message structure to use
  * @mask: result when function returns 0.
  *
  * LOCKING:
  * the caller has ec_dev->lock mutex, or the caller knows there is
  * no other command in progress.
  */
-static int fwk_ec_get_host_event_wake_mask(struct fwk_ec_device *ec_dev, uint32_t *mask)
+static int fwk_ec_get_host_event_wake_mask(struct fwk_ec_device *ec_dev, u64 *mask)
 {
 	struct fwk_ec_command *msg;
-	struct ec_response_host_event_mask *r;
+	struct ec_params_host_event *p;
+	struct ec_response_host_event *r;
+	struct ec_response_host_event_mask *r32;
 	int ret, mapped;
 
-	msg = kzalloc(sizeof(*msg) + sizeof(*r), GFP_KERNEL);
+	msg = kzalloc(sizeof(*msg) + max(sizeof(*p), sizeof(*r)), GFP_KERNEL);
 	if (!msg)
 		return -ENOMEM;
 
-	msg->command = EC_CMD_HOST_EVENT_GET_WAKE_MASK;
+	msg->command = EC_CMD_HOST_EVENT;
+	msg->outsize = sizeof(*p);
 	msg->insize = sizeof(*r);
 
+	p = (struct ec_params_host_event *)msg->data;
+	p->action = EC_HOST_EVENT_GET;
+	p->mask_type = EC_HOST_EVENT_ACTIVE_WAKE_MASK;
+
+	ret = fwk_ec_send_command(ec_dev, msg);
+	if (ret >= (int)sizeof(*r) && msg->result == EC_RES_SUCCESS) {
+		r = (struct ec_response_host_event *)msg->data;
+		*mask = r->value;
+		ret = 0;
+		goto exit;
+	}
+
+	memset(msg, 0, sizeof(*msg) + sizeof(*r32));
+	msg->command = EC_CMD_HOST_EVENT_GET_WAKE_MASK;
+	msg->insize = sizeof(*r32);
+
 	ret = fwk_ec_send_command(ec_dev, msg);
 	if (ret < 0)
 		goto exit;
@@ -280,8 +330,8 @@ static int fwk_ec_get_host_event_wake_mask(struct fwk_ec_device *ec_dev, uint32_
 		goto exit;
 	}
 
-	r = (struct ec_response_host_event_mask *)msg->data;
-	*mask = r->mask;
+	r32 = (struct ec_response_host_event_mask *)msg->data;
+	*mask = r32->mask;
 	ret = 0;
 exit:
 	kfree(msg);
@@ -313,8 +363,10 @@ static int fwk_ec_get_proto_info(struct fwk_ec_device *ec_dev, int devidx)
 	 * messages sent by kernel. There is no need to wait before next
 	 * attempt because we waited at least EC_MSG_DEADLINE_MS.
 	 */
-	if (ret == -ETIMEDOUT)
+	if (ret == -ETIMEDOUT) {
+		fwk_ec_stat_inc(&ec_dev->stats.proto, FWK_EC_STAT_RETRIES);
 		ret = fwk_ec_send_command(ec_dev, msg);
+	}
 
 	if (ret < 0) {
 		dev_dbg(ec_dev->dev,
@@ -486,6 +538,50 @@ exit:
 	return ret;
 }
 
+/*
+ * fwk_ec_read_host_event_memmap
+ *
+ * Read the raw host events mirrored by the EC at EC_MEMMAP_HOST_EVENTS.
+ *
+ * @ec_dev: EC device to read from
+ * @events: result when function returns 0.
+ *
+ * LOCKING:
+ * none, reading the memory map does not need ec_dev->lock.
+ */
+static int fwk_ec_read_host_event_memmap(struct fwk_ec_device *ec_dev, u64 *events)
+{
+	__le64 raw;
+	int ret;
+
+	ret = ec_dev->cmd_readmem(ec_dev, EC_MEMMAP_HOST_EVENTS, sizeof(raw), &raw);
+	if (ret < 0)
+		return ret;
+
+	*events = le64_to_cpu(raw);
+
+	/* Set when the EC has not initialized the host interface yet. */
+	if (*events & EC_HOST_EVENT_MASK(EC_HOST_EVENT_INVALID))
+		return -ENODATA;
+
+	return 0;
+}
+
+static bool fwk_ec_probe_host_event_memmap(struct fwk_ec_device *ec_dev)
+{
+	u8 version;
+	int ret;
+
+	if (!host_event_memmap || !ec_dev->cmd_readmem)
+		return false;
+
+	ret = ec_dev->cmd_readmem(ec_dev, EC_MEMMAP_EVENTS_VERSION, 1, &version);
+	if (ret < 0 || version != EC_MEMMAP_EVENTS_VERSION_1)
+		return false;
+
+	return !fwk_ec_read_host_event_memmap(ec_dev, &ec_dev->host_event_snapshot);
+}
+
 /**
  * fwk_ec_query_all() -  Query the protocol version supported by the
  *         ChromeOS EC.
@@ -544,6 +640,11 @@ int fwk_ec_query_all(struct fwk_ec_device *ec_dev)
 		dev_dbg(ec_dev->dev, "MKBP support version %u\n", ec_dev->mkbp_event_supported - 1);
 	}
 
+	/* Probe if the raw host events can be read from the memory map. */
+	ec_dev->host_event_memmap = fwk_ec_probe_host_event_memmap(ec_dev);
+	if (ec_dev->host_event_memmap)
+		dev_dbg(ec_dev->dev, "host events mirrored in memmap\n");
+
 	/* Probe if host sleep v1 is supported for S0ix failure detection. */
 	ret = fwk_ec_get_host_command_version_mask(ec_dev, EC_CMD_HOST_SLEEP_EVENT, &ver_mask);
 	ec_dev->host_sleep_v1 = (ret == 0 && (ver_mask & EC_VER_MASK(1)));
@@ -585,36 +686,204 @@ exit:
 EXPORT_SYMBOL(fwk_ec_query_all);
 
 /**
- * fwk_ec_cmd_xfer() - Send a command to the ChromeOS EC.
- * @ec_dev: EC device.
- * @msg: Message to write.
- *
- * Call this to send a command to the ChromeOS EC. This should be used instead
- * of calling the EC's cmd_xfer() callback directly. This function does not
- * convert EC command execution error codes to Linux error codes. Most
- * in-kernel users will want to use fwk_ec_cmd_xfer_status() instead since
- * that function implements the conversion.
+ * fwk_ec_latency_record() - Account a latency sample.
+ * @lat: Statistics to update.
+ * @ns: The sample, in nanoseconds.
  *
- * Return:
- * >0 - EC command was executed successfully. The return value is the number
- *      of bytes returned by the EC (excluding the header).
- * =0 - EC communication was successful. EC command execution results are
- *      reported in msg->result. The result will be EC_RES_SUCCESS if the
- *      command was executed successfully or report an EC command execution
- *      error.
- * <0 - EC communication error. Return value is the Linux error code.
+ * The caller serializes the updates of @lat.
  */
-int fwk_ec_cmd_xfer(struct fwk_ec_device *ec_dev, struct fwk_ec_command *msg)
+void fwk_ec_latency_record(struct fwk_ec_latency *lat, u64 ns)
 {
-	int ret;
+	if (!lat->count || ns < lat->min_ns)
+		lat->min_ns = ns;
+	if (ns > lat->max_ns)
+		lat->max_ns = ns;
+	lat->last_ns = ns;
+	lat->total_ns += ns;
+	lat->count++;
+}
+EXPORT_SYMBOL(fwk_ec_latency_record);
+
+/**
+ * struct fwk_ec_bus_waiter - Command waiting for the bus.
+ * @node: Links into the waiters list of its target.
+ * @ticket: Rank of the command in arrival order.
+ * @granted: Completed when the command is given the bus.
+ */
+struct fwk_ec_bus_waiter {
+	struct list_head node;
+	u64 ticket;
+	struct completion granted;
+};
+
+static unsigned int fwk_ec_bus_target(u32 command)
+{
+	return min_t(u32, command / EC_CMD_PASSTHRU_OFFSET(1),
+		     FWK_EC_BUS_TARGETS - 1);
+}
+
+/*
+ * Return the first target, from @first on, with waiting commands and bus
+ * time left, or -1 if there is none. Targets without waiting commands
+ * lose the bus time they have left, but keep their debt.
+ */
+static int fwk_ec_bus_pick(struct fwk_ec_bus *bus, unsigned int first,
+			   bool *pending)
+{
+	struct fwk_ec_bus_target *t;
+	unsigned int i, idx;
+
+	*pending = false;
+	for (i = 0; i < FWK_EC_BUS_TARGETS; i++) {
+		idx = (first + i) % FWK_EC_BUS_TARGETS;
+		t = &bus->targets[idx];
+
+		if (list_empty(&t->waiters)) {
+			t->deficit_ns = min_t(s64, t->deficit_ns, 0);
+			continue;
+		}
+
+		*pending = true;
+		if (t->deficit_ns > 0)
+			return idx;
+	}
+
+	return -1;
+}
+
+/*
+ * Deficit round robin: keep serving the current owner while it has bus
+ * time left, then move on to the next target which has. When none has,
+ * give every waiting target as many quanta as it takes for one to have
+ * some. Called with bus->lock held.
+ */
+static struct fwk_ec_bus_waiter *fwk_ec_bus_next(struct fwk_ec_bus *bus)
+{
+	s64 quantum = (s64)max_t(u32, bus->quantum_us, 1) * NSEC_PER_USEC;
+	struct fwk_ec_bus_waiter *waiter, *next = NULL;
+	struct fwk_ec_bus_target *t;
+	s64 rounds = S64_MAX;
+	bool pending;
+	int idx, i;
+
+	if (bus->fifo) {
+		/* Queues are in ticket order, the oldest is one of the heads. */
+		for (i = 0; i < FWK_EC_BUS_TARGETS; i++) {
+			waiter = list_first_entry_or_null(&bus->targets[i].waiters,
+							  struct fwk_ec_bus_waiter,
+							  node);
+			if (waiter && (!next || waiter->ticket < next->ticket)) {
+				next = waiter;
+				bus->owner = i;
+			}
+		}
+
+		return next;
+	}
+
+	idx = fwk_ec_bus_pick(bus, bus->owner, &pending);
+	if (idx < 0) {
+		if (!pending)
+			return NULL;
+
+		for (i = 0; i < FWK_EC_BUS_TARGETS; i++) {
+			t = &bus->targets[i];
+			if (!list_empty(&t->waiters))
+				rounds = min(rounds,
+					     div64_s64(-t->deficit_ns, quantum) + 1);
+		}
+		for (i = 0; i < FWK_EC_BUS_TARGETS; i++) {
+			t = &bus->targets[i];
+			if (!list_empty(&t->waiters))
+				t->deficit_ns += rounds * quantum;
+		}
 
+		/* The owner had its turn, start the new round after it. */
+		idx = fwk_ec_bus_pick(bus, bus->owner + 1, &pending);
+	}
+
+	bus->owner = idx;
+
+	return list_first_entry(&bus->targets[idx].waiters,
+				struct fwk_ec_bus_waiter, node);
+}
+
+/*
+ * Wait for our turn on the bus, then take ec_dev->lock. @queued and @start
+ * are set to the time the command was queued and got the bus.
+ */
+static void fwk_ec_bus_acquire(struct fwk_ec_device *ec_dev,
+			       unsigned int target,
+			       ktime_t *queued, ktime_t *start)
+{
+	struct fwk_ec_bus *bus = &ec_dev->bus;
+	struct fwk_ec_bus_waiter waiter;
+
+	*queued = ktime_get();
+
+	spin_lock(&bus->lock);
+	waiter.ticket = bus->next_ticket++;
+	if (!bus->busy) {
+		/* Nobody is waiting either, they are handed the bus. */
+		bus->busy = true;
+		bus->owner = target;
+		spin_unlock(&bus->lock);
+	} else {
+		fwk_ec_stat_inc(&ec_dev->stats.proto, FWK_EC_STAT_LOCK_WAITS);
+		init_completion(&waiter.granted);
+		list_add_tail(&waiter.node, &bus->targets[target].waiters);
+		spin_unlock(&bus->lock);
+		wait_for_completion(&waiter.granted);
+	}
+
+	*start = ktime_get();
 	mutex_lock(&ec_dev->lock);
+}
+
+/* Release ec_dev->lock and hand the bus over to the next command. */
+static void fwk_ec_bus_release(struct fwk_ec_device *ec_dev,
+			       unsigned int target, enum fwk_ec_bus_class cls,
+			       ktime_t queued, ktime_t start)
+{
+	struct fwk_ec_bus *bus = &ec_dev->bus;
+	struct fwk_ec_bus_target *t = &bus->targets[target];
+	struct fwk_ec_bus_class_stats *c = &bus->classes[cls];
+	s64 wait = ktime_to_ns(ktime_sub(start, queued));
+	struct fwk_ec_bus_waiter *next;
+	s64 service;
+
+	mutex_unlock(&ec_dev->lock);
+	service = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&bus->lock);
+	fwk_ec_latency_record(&t->wait, wait);
+	fwk_ec_latency_record(&t->service, service);
+	fwk_ec_latency_record(&c->wait, wait);
+	c->hist[min_t(unsigned int, fls64(div_u64(wait, NSEC_PER_USEC)),
+		      FWK_EC_BUS_HIST_BUCKETS - 1)]++;
+	t->deficit_ns -= service;
+
+	next = fwk_ec_bus_next(bus);
+	if (next) {
+		list_del(&next->node);
+		complete(&next->granted);
+	} else {
+		bus->busy = false;
+	}
+	spin_unlock(&bus->lock);
+}
+
+/* Send a command, with the bus held. */
+static int fwk_ec_xfer_locked(struct fwk_ec_device *ec_dev,
+			      struct fwk_ec_command *msg)
+{
+	int ret;
+
 	if (ec_dev->proto_version == EC_PROTO_VERSION_UNKNOWN) {
 		ret = fwk_ec_query_all(ec_dev);
 		if (ret) {
 			dev_err(ec_dev->dev,
 				"EC version unknown and query failed; aborting command\n");
-			mutex_unlock(&ec_dev->lock);
 			return ret;
 		}
 	}
@@ -630,7 +899,6 @@ int fwk_ec_cmd_xfer(struct fwk_ec_device *ec_dev, struct fwk_ec_command *msg)
 				"request of size %u is too big (max: %u)\n",
 				msg->outsize,
 				ec_dev->max_request);
-			mutex_unlock(&ec_dev->lock);
 			return -EMSGSIZE;
 		}
 	} else {
@@ -639,37 +907,109 @@ int fwk_ec_cmd_xfer(struct fwk_ec_device *ec_dev, struct fwk_ec_command *msg)
 				"passthru rq of size %u is too big (max: %u)\n",
 				msg->outsize,
 				ec_dev->max_passthru);
-			mutex_unlock(&ec_dev->lock);
 			return -EMSGSIZE;
 		}
 	}
 
-	ret = fwk_ec_send_command(ec_dev, msg);
-	mutex_unlock(&ec_dev->lock);
+	return fwk_ec_send_command(ec_dev, msg);
+}
 
-	return ret;
+/**
+ * fwk_ec_cmd_xfer() - Send a command to the ChromeOS EC.
+ * @ec_dev: EC device.
+ * @msg: Message to write.
+ *
+ * Call this to send a command to the ChromeOS EC. This should be used instead
+ * of calling the EC's cmd_xfer() callback directly. This function does not
+ * convert EC command execution error codes to Linux error codes. Most
+ * in-kernel users will want to use fwk_ec_cmd_xfer_status() instead since
+ * that function implements the conversion.
+ *
+ * Return:
+ * >0 - EC command was executed successfully. The return value is the number
+ *      of bytes returned by the EC (excluding the header).
+ * =0 - EC communication was successful. EC command execution results are
+ *      reported in msg->result. The result will be EC_RES_SUCCESS if the
+ *      command was executed successfully or report an EC command execution
+ *      error.
+ * <0 - EC communication error. Return value is the Linux error code.
+ */
+int fwk_ec_cmd_xfer(struct fwk_ec_device *ec_dev, struct fwk_ec_command *msg)
+{
+	return fwk_ec_cmd_xfer_class(ec_dev, msg, FWK_EC_BUS_CLASS_KERNEL);
 }
 EXPORT_SYMBOL(fwk_ec_cmd_xfer);
 
 /**
- * fwk_ec_cmd_xfer_status() - Send a command to the ChromeOS EC.
+ * fwk_ec_cmd_xfer_class() - Send a command to the ChromeOS EC.
  * @ec_dev: EC device.
  * @msg: Message to write.
+ * @cls: Class of the caller, the bus wait statistics are kept per class.
  *
- * Call this to send a command to the ChromeOS EC. This should be used instead of calling the EC's
- * cmd_xfer() callback directly. It returns success status only if both the command was transmitted
- * successfully and the EC replied with success status.
+ * Same as fwk_ec_cmd_xfer(), for callers which are not plain kernel
+ * drivers.
  *
- * Return:
- * >=0 - The number of bytes transferred.
- * <0 - Linux error code
+ * Return: see fwk_ec_cmd_xfer().
  */
-int fwk_ec_cmd_xfer_status(struct fwk_ec_device *ec_dev,
-			    struct fwk_ec_command *msg)
+int fwk_ec_cmd_xfer_class(struct fwk_ec_device *ec_dev,
+			  struct fwk_ec_command *msg,
+			  enum fwk_ec_bus_class cls)
+{
+	unsigned int target = fwk_ec_bus_target(msg->command);
+	ktime_t queued, start;
+	int ret;
+
+	fwk_ec_bus_acquire(ec_dev, target, &queued, &start);
+	ret = fwk_ec_xfer_locked(ec_dev, msg);
+	fwk_ec_bus_release(ec_dev, target, cls, queued, start);
+
+	return ret;
+}
+EXPORT_SYMBOL(fwk_ec_cmd_xfer_class);
+
+/**
+ * fwk_ec_cmd_xfer_batch() - Send several commands to the ChromeOS EC.
+ * @ec_dev: EC device.
+ * @msgs: Messages to write.
+ * @rets: Set to the fwk_ec_cmd_xfer() return value of each message.
+ * @count: Number of messages.
+ * @cls: Class of the caller, see fwk_ec_cmd_xfer_class().
+ *
+ * The commands are sent back to back, in order, without giving the bus
+ * up in between. To stay fair to the other callers, the bus is still
+ * handed over after FWK_EC_BUS_BATCH_MAX commands, once the batch used a
+ * bus quantum, or when the target of the commands changes, and the rest
+ * of the batch queues again.
+ */
+void fwk_ec_cmd_xfer_batch(struct fwk_ec_device *ec_dev,
+			   struct fwk_ec_command **msgs, int *rets,
+			   unsigned int count, enum fwk_ec_bus_class cls)
+{
+	unsigned int target, i = 0, n;
+	ktime_t queued, start;
+
+	while (i < count) {
+		target = fwk_ec_bus_target(msgs[i]->command);
+		fwk_ec_bus_acquire(ec_dev, target, &queued, &start);
+		for (n = 0; i < count && n < FWK_EC_BUS_BATCH_MAX; n++, i++) {
+			if (n && (fwk_ec_bus_target(msgs[i]->command) != target ||
+				  ktime_us_delta(ktime_get(), start) >=
+				  READ_ONCE(ec_dev->bus.quantum_us)))
+				break;
+			rets[i] = fwk_ec_xfer_locked(ec_dev, msgs[i]);
+		}
+		fwk_ec_bus_release(ec_dev, target, cls, queued, start);
+	}
+}
+EXPORT_SYMBOL(fwk_ec_cmd_xfer_batch);
+
+static int fwk_ec_xfer_status(struct fwk_ec_device *ec_dev,
+			      struct fwk_ec_command *msg,
+			      enum fwk_ec_bus_class cls)
 {
 	int ret, mapped;
 
-	ret = fwk_ec_cmd_xfer(ec_dev, msg);
+	ret = fwk_ec_cmd_xfer_class(ec_dev, msg, cls);
 	if (ret < 0)
 		return ret;
 
@@ -682,6 +1022,25 @@ int fwk_ec_cmd_xfer_status(struct fwk_ec_device *ec_dev,
 
 	return ret;
 }
+
+/**
+ * fwk_ec_cmd_xfer_status() - Send a command to the ChromeOS EC.
+ * @ec_dev: EC device.
+ * @msg: Message to write.
+ *
+ * Call this to send a command to the ChromeOS EC. This should be used instead of calling the EC's
+ * cmd_xfer() callback directly. It returns success status only if both the command was transmitted
+ * successfully and the EC replied with success status.
+ *
+ * Return:
+ * >=0 - The number of bytes transferred.
+ * <0 - Linux error code
+ */
+int fwk_ec_cmd_xfer_status(struct fwk_ec_device *ec_dev,
+			    struct fwk_ec_command *msg)
+{
+	return fwk_ec_xfer_status(ec_dev, msg, FWK_EC_BUS_CLASS_KERNEL);
+}
 EXPORT_SYMBOL(fwk_ec_cmd_xfer_status);
 
 static int get_next_event_xfer(struct fwk_ec_device *ec_dev,
@@ -696,7 +1055,7 @@ static int get_next_event_xfer(struct fwk_ec_device *ec_dev,
 	msg->insize = size;
 	msg->outsize = 0;
 
-	ret = fwk_ec_cmd_xfer_status(ec_dev, msg);
+	ret = fwk_ec_xfer_status(ec_dev, msg, FWK_EC_BUS_CLASS_EVENT);
 	if (ret > 0) {
 		ec_dev->event_size = ret - 1;
 		ec_dev->event_data = *event;
@@ -740,7 +1099,8 @@ static int get_keyboard_state_event(struct fwk_ec_device *ec_dev)
 	msg->insize = sizeof(ec_dev->event_data.data);
 	msg->outsize = 0;
 
-	ec_dev->event_size = fwk_ec_cmd_xfer_status(ec_dev, msg);
+	ec_dev->event_size = fwk_ec_xfer_status(ec_dev, msg,
+						   FWK_EC_BUS_CLASS_EVENT);
 	ec_dev->event_data.event_type = EC_MKBP_EVENT_KEY_MATRIX;
 	memcpy(&ec_dev->event_data.data, msg->data,
 	       sizeof(ec_dev->event_data.data));
@@ -748,6 +1108,230 @@ static int get_keyboard_state_event(struct fwk_ec_device *ec_dev)
 	return ec_dev->event_size;
 }
 
+/*
+ * Acknowledge @events in the main host event copy, so that the EC raising
+ * one of them again shows up as a new bit in the memory map.
+ */
+static int fwk_ec_clear_host_events(struct fwk_ec_device *ec_dev, u64 events)
+{
+	struct {
+		struct fwk_ec_command msg;
+		union {
+			struct ec_params_host_event req;
+			struct ec_params_host_event_mask req32;
+		} u;
+	} __packed buf;
+	int ret;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.msg.command = EC_CMD_HOST_EVENT;
+	buf.msg.outsize = sizeof(buf.u.req);
+	buf.u.req.action = EC_HOST_EVENT_CLEAR;
+	buf.u.req.mask_type = EC_HOST_EVENT_MAIN;
+	buf.u.req.value = events;
+
+	ret = fwk_ec_cmd_xfer_status(ec_dev, &buf.msg);
+	if (ret != -EOPNOTSUPP)
+		return ret < 0 ? ret : 0;
+
+	/* Older ECs only have the 32-bit command. */
+	memset(&buf, 0, sizeof(buf));
+	buf.msg.command = EC_CMD_HOST_EVENT_CLEAR;
+	buf.msg.outsize = sizeof(buf.u.req32);
+	buf.u.req32.mask = lower_32_bits(events);
+
+	ret = fwk_ec_cmd_xfer_status(ec_dev, &buf.msg);
+	return ret < 0 ? ret : 0;
+}
+
+/*
+ * Build a host event from the host events raised in the memory map since
+ * the previous snapshot, then acknowledge them to the EC. Only bits going
+ * from clear to set are reported, a bit the EC leaves set is reported once.
+ */
+static int get_host_event_memmap(struct fwk_ec_device *ec_dev)
+{
+	u64 events, raised;
+	int ret;
+
+	if (ec_dev->suspended) {
+		dev_dbg(ec_dev->dev, "Device suspended.\n");
+		return -EHOSTDOWN;
+	}
+
+	ret = fwk_ec_read_host_event_memmap(ec_dev, &events);
+	if (ret < 0)
+		return ret;
+
+	raised = events & ~ec_dev->host_event_snapshot;
+	ec_dev->host_event_snapshot = events;
+	if (!raised)
+		return 0;
+
+	/* If the EC can't clear them, they are still reported only once. */
+	if (!fwk_ec_clear_host_events(ec_dev, raised))
+		ec_dev->host_event_snapshot &= ~raised;
+
+	/* Keep the 32-bit event for consumers that only know about it. */
+	if (upper_32_bits(raised)) {
+		ec_dev->event_data.event_type = EC_MKBP_EVENT_HOST_EVENT64;
+		put_unaligned_le64(raised,
+				   &ec_dev->event_data.data.host_event64);
+		ec_dev->event_size = sizeof(u64);
+	} else {
+		ec_dev->event_data.event_type = EC_MKBP_EVENT_HOST_EVENT;
+		put_unaligned_le32(raised,
+				   &ec_dev->event_data.data.host_event);
+		ec_dev->event_size = sizeof(u32);
+	}
+
+	return ec_dev->event_size + 1;
+}
+
+/*
+ * Record the event just fetched into ec_dev->event_data in the event ring.
+ * Called from the event path only, so the ring has a single producer.
+ */
+static void fwk_ec_event_ring_push(struct fwk_ec_device *ec_dev)
+{
+	struct fwk_ec_event_ring *ring = &ec_dev->event_ring;
+	struct fwk_ec_event *event;
+
+	if (!ring->events)
+		return;
+
+	/* Stamp the current event for the notifiers, too. */
+	ec_dev->event_irq_time = ec_dev->last_event_time;
+	ec_dev->event_fetch_time = fwk_ec_get_time_ns();
+
+	spin_lock(&ring->lock);
+	event = &ring->events[ring->head & (FWK_EC_EVENT_RING_SIZE - 1)];
+	ec_dev->event_seq = ring->head;
+	event->seq = ring->head++;
+	event->irq_time = ec_dev->event_irq_time;
+	event->fetch_time = ec_dev->event_fetch_time;
+	event->queue_time = fwk_ec_get_time_ns();
+	event->size = ec_dev->event_size;
+	event->data = ec_dev->event_data;
+	spin_unlock(&ring->lock);
+
+	fwk_ec_stat_inc(&ec_dev->stats.proto, FWK_EC_STAT_EVENTS);
+	if (ec_dev->event_data.event_type < EC_MKBP_EVENT_COUNT)
+		fwk_ec_stat_inc(&ec_dev->stats.proto, FWK_EC_STAT_EVENT_TYPE +
+				ec_dev->event_data.event_type);
+}
+
+/**
+ * fwk_ec_event_cursor_init() - Start consuming the event ring.
+ * @ec_dev: Device whose event ring is read.
+ * @cursor: Cursor to initialize.
+ *
+ * The cursor is positioned after the most recent event, so the first
+ * fwk_ec_event_ring_read() returns the next event fetched from the EC.
+ */
+void fwk_ec_event_cursor_init(struct fwk_ec_device *ec_dev,
+			       struct fwk_ec_event_cursor *cursor)
+{
+	struct fwk_ec_event_ring *ring = &ec_dev->event_ring;
+
+	spin_lock(&ring->lock);
+	cursor->seq = ring->head;
+	cursor->lost = 0;
+	spin_unlock(&ring->lock);
+}
+EXPORT_SYMBOL(fwk_ec_event_cursor_init);
+
+/**
+ * fwk_ec_event_ring_read() - Read the next event from the event ring.
+ * @ec_dev: Device whose event ring is read.
+ * @cursor: Read position of the caller, advanced on success.
+ * @event: Where to copy the event.
+ *
+ * If the caller fell so far behind that unread events were overwritten, the
+ * cursor skips to the oldest event still in the ring and the number of
+ * skipped events is added to @cursor->lost.
+ *
+ * Return: 1 if an event was copied to @event, 0 if the ring holds no unread
+ * event.
+ */
+int fwk_ec_event_ring_read(struct fwk_ec_device *ec_dev,
+			    struct fwk_ec_event_cursor *cursor,
+			    struct fwk_ec_event *event)
+{
+	struct fwk_ec_event_ring *ring = &ec_dev->event_ring;
+	u64 oldest;
+	int ret = 0;
+
+	if (!ring->events)
+		return 0;
+
+	spin_lock(&ring->lock);
+	oldest = ring->head > FWK_EC_EVENT_RING_SIZE ?
+		 ring->head - FWK_EC_EVENT_RING_SIZE : 1;
+	if (cursor->seq < oldest) {
+		cursor->lost += oldest - cursor->seq;
+		ring->overruns += oldest - cursor->seq;
+		cursor->seq = oldest;
+	}
+
+	if (cursor->seq < ring->head) {
+		*event = ring->events[cursor->seq & (FWK_EC_EVENT_RING_SIZE - 1)];
+		cursor->seq++;
+		ret = 1;
+	}
+	spin_unlock(&ring->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(fwk_ec_event_ring_read);
+
+/**
+ * fwk_ec_event_ring_pending() - Check for unread events in the event ring.
+ * @ec_dev: Device whose event ring is read.
+ * @cursor: Read position of the caller.
+ *
+ * Return: true if fwk_ec_event_ring_read() would return an event.
+ */
+bool fwk_ec_event_ring_pending(struct fwk_ec_device *ec_dev,
+			       const struct fwk_ec_event_cursor *cursor)
+{
+	struct fwk_ec_event_ring *ring = &ec_dev->event_ring;
+	bool pending;
+
+	if (!ring->events)
+		return false;
+
+	spin_lock(&ring->lock);
+	pending = cursor->seq < ring->head;
+	spin_unlock(&ring->lock);
+
+	return pending;
+}
+EXPORT_SYMBOL(fwk_ec_event_ring_pending);
+
+static void fwk_ec_wake_stats_update(struct fwk_ec_device *ec_dev,
+				     u64 host_event, bool wake)
+{
+	struct fwk_ec_wake_stats *stats = &ec_dev->wake_stats;
+	u64 wake_bits = wake ? host_event & ec_dev->host_event_wake_mask : 0;
+	unsigned int bit;
+
+	spin_lock(&stats->lock);
+	while (host_event) {
+		bit = __ffs64(host_event);
+		host_event &= host_event - 1;
+
+		stats->seen[bit]++;
+		if (wake_bits & BIT_ULL(bit))
+			stats->wakes[bit]++;
+		else
+			stats->suppressed[bit]++;
+	}
+	if (wake)
+		stats->last_wake = fwk_ec_get_time_ns();
+	spin_unlock(&stats->lock);
+}
+
 /**
  * fwk_ec_get_next_event() - Fetch next event from the ChromeOS EC.
  * @ec_dev: Device to fetch event from.
@@ -764,14 +1348,15 @@ static int get_keyboard_state_event(struct fwk_ec_device *ec_dev)
  *
  * Return: negative error code on errors; 0 for no data; or else number of
  * bytes received (i.e., an event was retrieved successfully). Event types are
- * written out to @ec_dev->event_data.event_type on success.
+ * written out to @ec_dev->event_data.event_type on success, and the event is
+ * also recorded in @ec_dev->event_ring.
  */
 int fwk_ec_get_next_event(struct fwk_ec_device *ec_dev,
 			   bool *wake_event,
 			   bool *has_more_events)
 {
 	u8 event_type;
-	u32 host_event;
+	u64 host_event;
 	int ret;
 	u32 ver_mask;
 
@@ -791,10 +1376,32 @@ int fwk_ec_get_next_event(struct fwk_ec_device *ec_dev,
 	if (has_more_events)
 		*has_more_events = false;
 
-	if (!ec_dev->mkbp_event_supported)
-		return get_keyboard_state_event(ec_dev);
+	if (!ec_dev->mkbp_event_supported && !ec_dev->host_event_memmap) {
+		ret = get_keyboard_state_event(ec_dev);
+		if (ret > 0)
+			fwk_ec_event_ring_push(ec_dev);
+		return ret;
+	}
 
-	ret = get_next_event(ec_dev);
+	/*
+	 * LPC ECs without MKBP have no MKBP keyboard either, their events
+	 * are host events which can be read from the memmap.
+	 */
+	if (ec_dev->mkbp_event_supported) {
+		ret = get_next_event(ec_dev);
+	} else {
+		ret = get_host_event_memmap(ec_dev);
+		/*
+		 * The mirror can't be trusted, e.g. the EC is rebooting and
+		 * flagged it invalid: fall back to asking the EC.
+		 */
+		if (ret < 0 && ret != -EHOSTDOWN) {
+			ret = get_keyboard_state_event(ec_dev);
+			if (ret > 0)
+				fwk_ec_event_ring_push(ec_dev);
+			return ret;
+		}
+	}
 	/*
 	 * -ENOPROTOOPT is returned when EC returns EC_RES_INVALID_VERSION.
 	 * This can occur when EC based device (e.g. Fingerprint MCU) jumps to
@@ -834,9 +1441,11 @@ int fwk_ec_get_next_event(struct fwk_ec_device *ec_dev,
 			EC_MKBP_HAS_MORE_EVENTS;
 	ec_dev->event_data.event_type &= EC_MKBP_EVENT_TYPE_MASK;
 
+	fwk_ec_event_ring_push(ec_dev);
+
 	if (wake_event) {
 		event_type = ec_dev->event_data.event_type;
-		host_event = fwk_ec_get_host_event(ec_dev);
+		host_event = fwk_ec_get_host_event64(ec_dev);
 
 		/*
 		 * Sensor events need to be parsed by the sensor sub-device.
@@ -851,6 +1460,9 @@ int fwk_ec_get_next_event(struct fwk_ec_device *ec_dev,
 			/* Masked host-events should not count as wake events. */
 			if (!(host_event & ec_dev->host_event_wake_mask))
 				*wake_event = false;
+
+			fwk_ec_wake_stats_update(ec_dev, host_event,
+						 *wake_event);
 		}
 	}
 
@@ -858,37 +1470,580 @@ int fwk_ec_get_next_event(struct fwk_ec_device *ec_dev,
 }
 EXPORT_SYMBOL(fwk_ec_get_next_event);
 
+/*
+ * Decode the host event bits of an MKBP event.
+ *
+ * Return: 0 with *host_event set, -ENOENT if the event isn't a host event,
+ * -EINVAL for a host event of the wrong size.
+ */
+static int fwk_ec_decode_host_event(u8 event_type, int size,
+				    const union ec_response_get_next_data_v1 *data,
+				    u64 *host_event)
+{
+	switch (event_type) {
+	case EC_MKBP_EVENT_HOST_EVENT:
+		if (size != sizeof(u32))
+			return -EINVAL;
+		*host_event = get_unaligned_le32(&data->host_event);
+		return 0;
+	case EC_MKBP_EVENT_HOST_EVENT64:
+		if (size != sizeof(u64))
+			return -EINVAL;
+		*host_event = get_unaligned_le64(&data->host_event64);
+		return 0;
+	default:
+		return -ENOENT;
+	}
+}
+
 /**
- * fwk_ec_get_host_event() - Return a mask of event set by the ChromeOS EC.
+ * fwk_ec_get_host_event64() - Return a mask of event set by the ChromeOS EC.
  * @ec_dev: Device to fetch event from.
  *
  * When MKBP is supported, when the EC raises an interrupt, we collect the
  * events raised and call the functions in the ec notifier. This function
- * is a helper to know which events are raised.
+ * is a helper to know which events are raised. Both
+ * EC_MKBP_EVENT_HOST_EVENT and EC_MKBP_EVENT_HOST_EVENT64 events are
+ * handled.
  *
  * Return: 0 on error or non-zero bitmask of one or more EC_HOST_EVENT_*.
  */
-u32 fwk_ec_get_host_event(struct fwk_ec_device *ec_dev)
+u64 fwk_ec_get_host_event64(struct fwk_ec_device *ec_dev)
 {
-	u32 host_event;
-
-	if (!ec_dev->mkbp_event_supported)
-		return 0;
+	u64 host_event;
+	int ret;
 
-	if (ec_dev->event_data.event_type != EC_MKBP_EVENT_HOST_EVENT)
+	if (!ec_dev->mkbp_event_supported && !ec_dev->host_event_memmap)
 		return 0;
 
-	if (ec_dev->event_size != sizeof(host_event)) {
+	ret = fwk_ec_decode_host_event(ec_dev->event_data.event_type,
+				       ec_dev->event_size,
+				       &ec_dev->event_data.data, &host_event);
+	if (ret == -EINVAL)
 		dev_warn(ec_dev->dev, "Invalid host event size\n");
-		return 0;
-	}
 
-	host_event = get_unaligned_le32(&ec_dev->event_data.data.host_event);
+	return ret ? 0 : host_event;
+}
+EXPORT_SYMBOL(fwk_ec_get_host_event64);
 
-	return host_event;
+/**
+ * fwk_ec_get_host_event() - Return a mask of event set by the ChromeOS EC.
+ * @ec_dev: Device to fetch event from.
+ *
+ * Same as fwk_ec_get_host_event64(), limited to the first 32 host events.
+ *
+ * Return: 0 on error or non-zero bitmask of one or more EC_HOST_EVENT_*.
+ */
+u32 fwk_ec_get_host_event(struct fwk_ec_device *ec_dev)
+{
+	return lower_32_bits(fwk_ec_get_host_event64(ec_dev));
 }
 EXPORT_SYMBOL(fwk_ec_get_host_event);
 
+/* Must be called with ec_dev->event_subscribers_rwsem held for writing. */
+static void fwk_ec_link_event_subscriber(struct fwk_ec_device *ec_dev,
+					 struct fwk_ec_event_subscriber *sub)
+{
+	int type;
+
+	for (type = 0; type < EC_MKBP_EVENT_COUNT; type++) {
+		if (sub->event_types & BIT(type))
+			list_add_tail(&sub->links[type].node,
+				      &ec_dev->event_subscribers[type]);
+	}
+}
+
+/* Must be called with ec_dev->event_subscribers_rwsem held for writing. */
+static void fwk_ec_unlink_event_subscriber(struct fwk_ec_event_subscriber *sub)
+{
+	int type;
+
+	for (type = 0; type < EC_MKBP_EVENT_COUNT; type++)
+		list_del_init(&sub->links[type].node);
+}
+
+/**
+ * fwk_ec_register_event_subscriber() - Subscribe to some MKBP event types.
+ * @ec_dev: Device whose events are wanted.
+ * @sub: Subscriber, with @sub->nb.notifier_call, @sub->event_types and
+ *       @sub->host_event_mask filled in.
+ *
+ * Unlike the event_notifier chain, which is walked for every event, the
+ * subscriber is only called for the event types it asked for. Use
+ * fwk_ec_update_event_subscriber() to change them later on.
+ *
+ * Return: 0 on success or negative error code.
+ */
+int fwk_ec_register_event_subscriber(struct fwk_ec_device *ec_dev,
+				      struct fwk_ec_event_subscriber *sub)
+{
+	int type;
+
+	if (!sub->nb.notifier_call)
+		return -EINVAL;
+
+	for (type = 0; type < EC_MKBP_EVENT_COUNT; type++) {
+		sub->links[type].sub = sub;
+		INIT_LIST_HEAD(&sub->links[type].node);
+	}
+
+	down_write(&ec_dev->event_subscribers_rwsem);
+	fwk_ec_link_event_subscriber(ec_dev, sub);
+	up_write(&ec_dev->event_subscribers_rwsem);
+
+	return 0;
+}
+EXPORT_SYMBOL(fwk_ec_register_event_subscriber);
+
+/**
+ * fwk_ec_update_event_subscriber() - Change what a subscriber is notified of.
+ * @ec_dev: Device the subscriber is registered with.
+ * @sub: Registered subscriber.
+ * @event_types: New bitmap of BIT(EC_MKBP_EVENT_*) types.
+ * @host_event_mask: New host event filter, see struct fwk_ec_event_subscriber.
+ */
+void fwk_ec_update_event_subscriber(struct fwk_ec_device *ec_dev,
+				     struct fwk_ec_event_subscriber *sub,
+				     unsigned long event_types,
+				     u64 host_event_mask)
+{
+	down_write(&ec_dev->event_subscribers_rwsem);
+	fwk_ec_unlink_event_subscriber(sub);
+	sub->event_types = event_types;
+	sub->host_event_mask = host_event_mask;
+	fwk_ec_link_event_subscriber(ec_dev, sub);
+	up_write(&ec_dev->event_subscribers_rwsem);
+}
+EXPORT_SYMBOL(fwk_ec_update_event_subscriber);
+
+/**
+ * fwk_ec_unregister_event_subscriber() - Remove a registered event subscriber.
+ * @ec_dev: Device the subscriber was registered with.
+ * @sub: Subscriber to remove.
+ *
+ * Once this returns, @sub->nb.notifier_call is not running and will not be
+ * called again.
+ */
+void fwk_ec_unregister_event_subscriber(struct fwk_ec_device *ec_dev,
+					 struct fwk_ec_event_subscriber *sub)
+{
+	down_write(&ec_dev->event_subscribers_rwsem);
+	fwk_ec_unlink_event_subscriber(sub);
+	up_write(&ec_dev->event_subscribers_rwsem);
+}
+EXPORT_SYMBOL(fwk_ec_unregister_event_subscriber);
+
+/**
+ * fwk_ec_host_event_match() - Check an MKBP event against a host event filter.
+ * @event_type: EC_MKBP_EVENT_* type of the event.
+ * @size: Size of the event data.
+ * @data: Event data.
+ * @host_event_mask: Filter, see struct fwk_ec_event_subscriber.
+ *
+ * Events other than host events always match, and so does anything when
+ * @host_event_mask is 0. A host event of the wrong size has no bits to match
+ * and is filtered out.
+ *
+ * Return: true if the event passes the filter.
+ */
+bool fwk_ec_host_event_match(u8 event_type, int size,
+			     const union ec_response_get_next_data_v1 *data,
+			     u64 host_event_mask)
+{
+	u64 host_event;
+	int ret;
+
+	if (!host_event_mask)
+		return true;
+
+	ret = fwk_ec_decode_host_event(event_type, size, data, &host_event);
+	if (ret == -ENOENT)
+		return true;
+
+	return !ret && (host_event & host_event_mask);
+}
+EXPORT_SYMBOL(fwk_ec_host_event_match);
+
+/**
+ * fwk_ec_notify_event() - Forward the current event to its consumers.
+ * @ec_dev: Device the event was fetched from.
+ * @queued_during_suspend: 1 if the event was queued while suspended.
+ *
+ * Call this after fwk_ec_get_next_event() returned an event. The whole
+ * event_notifier chain is called, then only the subscribers registered for
+ * the event type in @ec_dev->event_data.
+ */
+void fwk_ec_notify_event(struct fwk_ec_device *ec_dev,
+			  unsigned long queued_during_suspend)
+{
+	u8 event_type = ec_dev->event_data.event_type;
+	struct fwk_ec_event_subscriber *sub;
+	struct fwk_ec_event_link *link;
+	int ret;
+
+	blocking_notifier_call_chain(&ec_dev->event_notifier,
+				     queued_during_suspend, ec_dev);
+
+	if (event_type >= EC_MKBP_EVENT_COUNT)
+		return;
+
+	down_read(&ec_dev->event_subscribers_rwsem);
+	list_for_each_entry(link, &ec_dev->event_subscribers[event_type], node) {
+		sub = link->sub;
+		if (!fwk_ec_host_event_match(event_type, ec_dev->event_size,
+					     &ec_dev->event_data.data,
+					     sub->host_event_mask))
+			continue;
+
+		ret = sub->nb.notifier_call(&sub->nb, queued_during_suspend,
+					    ec_dev);
+		if (ret & NOTIFY_STOP_MASK)
+			break;
+	}
+	up_read(&ec_dev->event_subscribers_rwsem);
+}
+EXPORT_SYMBOL(fwk_ec_notify_event);
+
+/* Mask types managed by the host event mask manager, in cache order. */
+static const u8 fwk_ec_managed_masks[FWK_EC_HOST_EVENT_MASKS] = {
+	EC_HOST_EVENT_SCI_MASK,
+	EC_HOST_EVENT_SMI_MASK,
+	EC_HOST_EVENT_ACTIVE_WAKE_MASK,
+	EC_HOST_EVENT_LAZY_WAKE_MASK_S0IX,
+	EC_HOST_EVENT_LAZY_WAKE_MASK_S3,
+};
+
+static int fwk_ec_host_event_mask_index(u8 mask_type)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fwk_ec_managed_masks); i++)
+		if (fwk_ec_managed_masks[i] == mask_type)
+			return i;
+
+	return -EINVAL;
+}
+
+static bool fwk_ec_host_event_mask_is_lazy(u8 mask_type)
+{
+	return mask_type == EC_HOST_EVENT_LAZY_WAKE_MASK_S0IX ||
+	       mask_type == EC_HOST_EVENT_LAZY_WAKE_MASK_S3;
+}
+
+/*
+ * Read or write one host event mask in the EC, through EC_CMD_HOST_EVENT or
+ * the legacy per-mask commands. The lazy wake masks have no legacy command.
+ */
+static int fwk_ec_host_event_mask_xfer(struct fwk_ec_device *ec_dev,
+				       u8 mask_type, bool set, u64 *value)
+{
+	struct {
+		struct fwk_ec_command msg;
+		union {
+			struct ec_params_host_event req;
+			struct ec_response_host_event resp;
+			struct ec_params_host_event_mask req32;
+			struct ec_response_host_event_mask resp32;
+		} u;
+	} __packed buf;
+	int ret;
+
+	memset(&buf, 0, sizeof(buf));
+
+	if (ec_dev->host_event_masks.unified) {
+		buf.msg.command = EC_CMD_HOST_EVENT;
+		buf.msg.outsize = sizeof(buf.u.req);
+		buf.u.req.action = set ? EC_HOST_EVENT_SET : EC_HOST_EVENT_GET;
+		buf.u.req.mask_type = mask_type;
+		if (set)
+			buf.u.req.value = *value;
+		else
+			buf.msg.insize = sizeof(buf.u.resp);
+	} else {
+		switch (mask_type) {
+		case EC_HOST_EVENT_SCI_MASK:
+			buf.msg.command = set ? EC_CMD_HOST_EVENT_SET_SCI_MASK :
+						EC_CMD_HOST_EVENT_GET_SCI_MASK;
+			break;
+		case EC_HOST_EVENT_SMI_MASK:
+			buf.msg.command = set ? EC_CMD_HOST_EVENT_SET_SMI_MASK :
+						EC_CMD_HOST_EVENT_GET_SMI_MASK;
+			break;
+		case EC_HOST_EVENT_ACTIVE_WAKE_MASK:
+			buf.msg.command = set ? EC_CMD_HOST_EVENT_SET_WAKE_MASK :
+						EC_CMD_HOST_EVENT_GET_WAKE_MASK;
+			break;
+		default:
+			return -EOPNOTSUPP;
+		}
+
+		if (set) {
+			buf.msg.outsize = sizeof(buf.u.req32);
+			buf.u.req32.mask = lower_32_bits(*value);
+		} else {
+			buf.msg.insize = sizeof(buf.u.resp32);
+		}
+	}
+
+	ret = fwk_ec_cmd_xfer_status(ec_dev, &buf.msg);
+	if (ret < 0)
+		return ret;
+
+	if (!set) {
+		if (ret < buf.msg.insize)
+			return -EPROTO;
+		*value = ec_dev->host_event_masks.unified ? buf.u.resp.value :
+							    buf.u.resp32.mask;
+	}
+
+	return 0;
+}
+
+/*
+ * Program mask @i if its effective value differs from the cached one, so
+ * the EC only gets a command when the mask changes. Called with the lock
+ * held.
+ */
+static int fwk_ec_host_event_mask_apply(struct fwk_ec_device *ec_dev, int i)
+{
+	struct fwk_ec_host_event_masks *masks = &ec_dev->host_event_masks;
+	struct fwk_ec_host_event_mask *m = &masks->masks[i];
+	u8 mask_type = fwk_ec_managed_masks[i];
+	u64 value;
+	int ret;
+
+	if (!m->valid)
+		return -ENODEV;
+
+	value = m->base | m->requested;
+	/* Events requested as wake events wake us from any sleep state. */
+	if (fwk_ec_host_event_mask_is_lazy(mask_type)) {
+		i = fwk_ec_host_event_mask_index(EC_HOST_EVENT_ACTIVE_WAKE_MASK);
+		value |= masks->masks[i].requested;
+	}
+
+	if (!masks->unified)
+		value = lower_32_bits(value);
+
+	if (value != m->value) {
+		ret = fwk_ec_host_event_mask_xfer(ec_dev, mask_type, true,
+						  &value);
+		if (ret < 0)
+			return ret;
+		m->value = value;
+	}
+
+	if (mask_type == EC_HOST_EVENT_ACTIVE_WAKE_MASK)
+		ec_dev->host_event_wake_mask = value;
+
+	return 0;
+}
+
+/**
+ * fwk_ec_host_event_masks_sync() - Fill or refresh the host event mask cache.
+ * @ec_dev: EC device.
+ *
+ * Read the SCI, SMI and wake masks from the EC. The first value read for a
+ * mask is the firmware setting, which is always kept. The next calls, e.g.
+ * once the EC signalled EC_HOST_EVENT_INTERFACE_READY after a reboot,
+ * program the masks again if the EC lost the events requested by consumers.
+ *
+ * Must not be called with ec_dev->lock held.
+ *
+ * Return: 0 on success, -ENODEV if no mask could be read.
+ */
+int fwk_ec_host_event_masks_sync(struct fwk_ec_device *ec_dev)
+{
+	struct fwk_ec_host_event_masks *masks = &ec_dev->host_event_masks;
+	struct fwk_ec_host_event_mask *m;
+	int ret = -ENODEV;
+	u64 value, sci;
+	int i, err, sci_err;
+
+	mutex_lock(&masks->lock);
+
+	/* Reading the SCI mask also tells which commands the EC has. */
+	masks->unified = true;
+	sci_err = fwk_ec_host_event_mask_xfer(ec_dev, EC_HOST_EVENT_SCI_MASK,
+					      false, &sci);
+	if (sci_err == -EOPNOTSUPP) {
+		masks->unified = false;
+		sci_err = fwk_ec_host_event_mask_xfer(ec_dev,
+						      EC_HOST_EVENT_SCI_MASK,
+						      false, &sci);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(fwk_ec_managed_masks); i++) {
+		m = &masks->masks[i];
+
+		if (fwk_ec_managed_masks[i] == EC_HOST_EVENT_SCI_MASK) {
+			err = sci_err;
+			value = sci;
+		} else {
+			err = fwk_ec_host_event_mask_xfer(ec_dev,
+							  fwk_ec_managed_masks[i],
+							  false, &value);
+		}
+		if (err < 0)
+			continue;
+
+		if (!m->valid)
+			m->base = value;
+		m->value = value;
+		m->valid = true;
+		ret = 0;
+
+		/* Lazy wake masks are only programmed before sleeping. */
+		if (!fwk_ec_host_event_mask_is_lazy(fwk_ec_managed_masks[i]))
+			fwk_ec_host_event_mask_apply(ec_dev, i);
+	}
+
+	i = fwk_ec_host_event_mask_index(EC_HOST_EVENT_ACTIVE_WAKE_MASK);
+	if (masks->masks[i].valid)
+		ec_dev->host_event_wake_mask = masks->masks[i].value;
+
+	mutex_unlock(&masks->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(fwk_ec_host_event_masks_sync);
+
+/**
+ * fwk_ec_host_event_mask_get() - Add host events to a mask of the EC.
+ * @ec_dev: EC device.
+ * @mask_type: EC_HOST_EVENT_SCI_MASK, EC_HOST_EVENT_SMI_MASK,
+ *             EC_HOST_EVENT_ACTIVE_WAKE_MASK or one of the lazy wake masks.
+ * @events: EC_HOST_EVENT_MASK() bits to add.
+ *
+ * Events are reference counted, the mask is only written to the EC when
+ * the resulting mask differs from the one it has. Events added to the active
+ * wake mask are added to the lazy wake masks too, when entering sleep.
+ *
+ * Return: 0 on success, negative error code otherwise. The reference counts
+ * are left untouched on error.
+ */
+int fwk_ec_host_event_mask_get(struct fwk_ec_device *ec_dev, u8 mask_type,
+			       u64 events)
+{
+	struct fwk_ec_host_event_masks *masks = &ec_dev->host_event_masks;
+	int i = fwk_ec_host_event_mask_index(mask_type);
+	struct fwk_ec_host_event_mask *m;
+	u64 old_requested, bits;
+	unsigned int bit;
+	int ret = 0;
+
+	if (i < 0)
+		return i;
+
+	m = &masks->masks[i];
+
+	mutex_lock(&masks->lock);
+	old_requested = m->requested;
+	for (bits = events; bits; bits &= bits - 1) {
+		bit = __ffs64(bits);
+		if (!m->refs[bit]++)
+			m->requested |= BIT_ULL(bit);
+	}
+
+	if (!fwk_ec_host_event_mask_is_lazy(mask_type) &&
+	    m->requested != old_requested) {
+		ret = fwk_ec_host_event_mask_apply(ec_dev, i);
+		if (ret < 0) {
+			for (bits = events; bits; bits &= bits - 1)
+				m->refs[__ffs64(bits)]--;
+			m->requested = old_requested;
+		}
+	}
+	mutex_unlock(&masks->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(fwk_ec_host_event_mask_get);
+
+/**
+ * fwk_ec_host_event_mask_put() - Drop host events added to a mask of the EC.
+ * @ec_dev: EC device.
+ * @mask_type: Mask given to fwk_ec_host_event_mask_get().
+ * @events: Events given to fwk_ec_host_event_mask_get().
+ *
+ * Events which are part of the firmware setting stay in the mask.
+ */
+void fwk_ec_host_event_mask_put(struct fwk_ec_device *ec_dev, u8 mask_type,
+				u64 events)
+{
+	struct fwk_ec_host_event_masks *masks = &ec_dev->host_event_masks;
+	int i = fwk_ec_host_event_mask_index(mask_type);
+	struct fwk_ec_host_event_mask *m;
+	u64 old_requested, bits;
+	unsigned int bit;
+	int ret;
+
+	if (i < 0)
+		return;
+
+	m = &masks->masks[i];
+
+	mutex_lock(&masks->lock);
+	old_requested = m->requested;
+	for (bits = events; bits; bits &= bits - 1) {
+		bit = __ffs64(bits);
+		if (WARN_ON(!m->refs[bit]))
+			continue;
+		if (!--m->refs[bit])
+			m->requested &= ~BIT_ULL(bit);
+	}
+
+	if (!fwk_ec_host_event_mask_is_lazy(mask_type) &&
+	    m->requested != old_requested) {
+		ret = fwk_ec_host_event_mask_apply(ec_dev, i);
+		if (ret < 0 && ret != -ENODEV)
+			dev_warn(ec_dev->dev,
+				 "failed to update host event mask %u: %d\n",
+				 mask_type, ret);
+	}
+	mutex_unlock(&masks->lock);
+}
+EXPORT_SYMBOL(fwk_ec_host_event_mask_put);
+
+/**
+ * fwk_ec_host_event_masks_prepare_sleep() - Program the lazy wake mask.
+ * @ec_dev: EC device.
+ * @sleep_event: HOST_SLEEP_EVENT_S0IX_SUSPEND or HOST_SLEEP_EVENT_S3_SUSPEND.
+ *
+ * Make sure the lazy wake mask the EC applies in the sleep state about to
+ * be entered holds the firmware setting plus all the events consumers want
+ * to be woken up by. The EC is only sent a command if that changed.
+ *
+ * Return: 0 on success or if the EC has no lazy wake masks, negative error
+ * code otherwise.
+ */
+int fwk_ec_host_event_masks_prepare_sleep(struct fwk_ec_device *ec_dev,
+					  u8 sleep_event)
+{
+	struct fwk_ec_host_event_masks *masks = &ec_dev->host_event_masks;
+	u8 mask_type;
+	int ret;
+
+	switch (sleep_event) {
+	case HOST_SLEEP_EVENT_S0IX_SUSPEND:
+		mask_type = EC_HOST_EVENT_LAZY_WAKE_MASK_S0IX;
+		break;
+	case HOST_SLEEP_EVENT_S3_SUSPEND:
+		mask_type = EC_HOST_EVENT_LAZY_WAKE_MASK_S3;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	mutex_lock(&masks->lock);
+	ret = fwk_ec_host_event_mask_apply(ec_dev,
+				fwk_ec_host_event_mask_index(mask_type));
+	mutex_unlock(&masks->lock);
+
+	return ret == -ENODEV ? 0 : ret;
+}
+EXPORT_SYMBOL(fwk_ec_host_event_masks_prepare_sleep);
+
 /**
  * fwk_ec_check_features() - Test for the presence of EC features
  *
@@ -905,17 +2060,24 @@ bool fwk_ec_check_features(struct fwk_ec_dev *ec, int feature)
 	struct ec_response_get_features *features = &ec->features;
 	int ret;
 
-	if (features->flags[0] == -1U && features->flags[1] == -1U) {
-		/* features bitmap not read yet */
-		ret = fwk_ec_cmd(ec->ec_dev, 0, EC_CMD_GET_FEATURES + ec->cmd_offset,
-				  NULL, 0, features, sizeof(*features));
-		if (ret < 0) {
-			dev_warn(ec->dev, "cannot get EC features: %d\n", ret);
-			memset(features, 0, sizeof(*features));
+	/* Pairs with the release below, the bitmap is read only once. */
+	if (!smp_load_acquire(&ec->features_read)) {
+		mutex_lock(&ec->features_lock);
+		if (!ec->features_read) {
+			ret = fwk_ec_cmd(ec->ec_dev, 0,
+					  EC_CMD_GET_FEATURES + ec->cmd_offset,
+					  NULL, 0, features, sizeof(*features));
+			if (ret < 0) {
+				dev_warn(ec->dev, "cannot get EC features: %d\n",
+					 ret);
+				memset(features, 0, sizeof(*features));
+			}
+
+			dev_dbg(ec->dev, "EC features %08x %08x\n",
+				features->flags[0], features->flags[1]);
+			smp_store_release(&ec->features_read, true);
 		}
-
-		dev_dbg(ec->dev, "EC features %08x %08x\n",
-			features->flags[0], features->flags[1]);
+		mutex_unlock(&ec->features_lock);
 	}
 
 	return !!(features->flags[feature / 32] & EC_FEATURE_MASK_0(feature));
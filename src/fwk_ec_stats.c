@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0
+// Statistics of the ChromeOS Embedded Controller stack
+
+#include <linux/device.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <fwk_ec_commands.h>
+#include <fwk_ec_proto.h>
+
+#define FWK_EC_STAT_RESULT_NAME(res, name) \
+	[FWK_EC_STAT_RESULT + EC_RES_##res] = "result." name
+#define FWK_EC_STAT_EVENT_NAME(type, name) \
+	[FWK_EC_STAT_EVENT_TYPE + EC_MKBP_EVENT_##type] = "event." name
+
+static const char * const fwk_ec_proto_stat_names[FWK_EC_PROTO_STATS] = {
+	[FWK_EC_STAT_COMMANDS] = "commands",
+	[FWK_EC_STAT_BYTES_OUT] = "bytes_out",
+	[FWK_EC_STAT_BYTES_IN] = "bytes_in",
+	[FWK_EC_STAT_XFER_ERRORS] = "xfer_errors",
+	[FWK_EC_STAT_TIMEOUTS] = "timeouts",
+	[FWK_EC_STAT_RETRIES] = "retries",
+	[FWK_EC_STAT_LOCK_WAITS] = "lock_waits",
+	[FWK_EC_STAT_EVENTS] = "events",
+	FWK_EC_STAT_RESULT_NAME(SUCCESS, "success"),
+	FWK_EC_STAT_RESULT_NAME(INVALID_COMMAND, "invalid_command"),
+	FWK_EC_STAT_RESULT_NAME(ERROR, "error"),
+	FWK_EC_STAT_RESULT_NAME(INVALID_PARAM, "invalid_param"),
+	FWK_EC_STAT_RESULT_NAME(ACCESS_DENIED, "access_denied"),
+	FWK_EC_STAT_RESULT_NAME(INVALID_RESPONSE, "invalid_response"),
+	FWK_EC_STAT_RESULT_NAME(INVALID_VERSION, "invalid_version"),
+	FWK_EC_STAT_RESULT_NAME(INVALID_CHECKSUM, "invalid_checksum"),
+	FWK_EC_STAT_RESULT_NAME(IN_PROGRESS, "in_progress"),
+	FWK_EC_STAT_RESULT_NAME(UNAVAILABLE, "unavailable"),
+	FWK_EC_STAT_RESULT_NAME(TIMEOUT, "timeout"),
+	FWK_EC_STAT_RESULT_NAME(OVERFLOW, "overflow"),
+	FWK_EC_STAT_RESULT_NAME(INVALID_HEADER, "invalid_header"),
+	FWK_EC_STAT_RESULT_NAME(REQUEST_TRUNCATED, "request_truncated"),
+	FWK_EC_STAT_RESULT_NAME(RESPONSE_TOO_BIG, "response_too_big"),
+	FWK_EC_STAT_RESULT_NAME(BUS_ERROR, "bus_error"),
+	FWK_EC_STAT_RESULT_NAME(BUSY, "busy"),
+	FWK_EC_STAT_RESULT_NAME(INVALID_HEADER_VERSION, "invalid_header_version"),
+	FWK_EC_STAT_RESULT_NAME(INVALID_HEADER_CRC, "invalid_header_crc"),
+	FWK_EC_STAT_RESULT_NAME(INVALID_DATA_CRC, "invalid_data_crc"),
+	FWK_EC_STAT_RESULT_NAME(DUP_UNAVAILABLE, "dup_unavailable"),
+	[FWK_EC_STAT_RESULT + FWK_EC_STAT_RESULTS - 1] = "result.other",
+	FWK_EC_STAT_EVENT_NAME(KEY_MATRIX, "key_matrix"),
+	FWK_EC_STAT_EVENT_NAME(HOST_EVENT, "host_event"),
+	FWK_EC_STAT_EVENT_NAME(SENSOR_FIFO, "sensor_fifo"),
+	FWK_EC_STAT_EVENT_NAME(BUTTON, "button"),
+	FWK_EC_STAT_EVENT_NAME(SWITCH, "switch"),
+	FWK_EC_STAT_EVENT_NAME(FINGERPRINT, "fingerprint"),
+	FWK_EC_STAT_EVENT_NAME(SYSRQ, "sysrq"),
+	FWK_EC_STAT_EVENT_NAME(HOST_EVENT64, "host_event64"),
+	FWK_EC_STAT_EVENT_NAME(CEC_EVENT, "cec_event"),
+	FWK_EC_STAT_EVENT_NAME(CEC_MESSAGE, "cec_message"),
+	FWK_EC_STAT_EVENT_NAME(PCHG, "pchg"),
+};
+
+static void fwk_ec_stats_group_free(void *data)
+{
+	struct fwk_ec_stats_group *group = data;
+
+	free_percpu(group->counters);
+	group->counters = NULL;
+}
+
+/**
+ * devm_fwk_ec_stats_group_init() - Allocate the counters of a group.
+ * @dev: Device the counters are freed with.
+ * @group: Group, with @name, @names and @count set.
+ *
+ * Counters can be updated as soon as this returns, even before the group
+ * is registered.
+ *
+ * Return: 0 on success or negative error code.
+ */
+int devm_fwk_ec_stats_group_init(struct device *dev,
+				 struct fwk_ec_stats_group *group)
+{
+	INIT_LIST_HEAD(&group->node);
+
+	group->counters = __alloc_percpu(group->count * sizeof(u64),
+					 __alignof__(u64));
+	if (!group->counters)
+		return -ENOMEM;
+
+	return devm_add_action_or_reset(dev, fwk_ec_stats_group_free, group);
+}
+EXPORT_SYMBOL(devm_fwk_ec_stats_group_init);
+
+/**
+ * fwk_ec_stats_init() - Set up the statistics registry of an EC device.
+ * @ec_dev: EC device.
+ *
+ * Called first thing when the device is registered, the protocol layer
+ * counters are live from then on.
+ *
+ * Return: 0 on success or negative error code.
+ */
+int fwk_ec_stats_init(struct fwk_ec_device *ec_dev)
+{
+	struct fwk_ec_stats *stats = &ec_dev->stats;
+	int ret;
+
+	mutex_init(&stats->lock);
+	INIT_LIST_HEAD(&stats->groups);
+
+	stats->proto.name = "proto";
+	stats->proto.names = fwk_ec_proto_stat_names;
+	stats->proto.count = FWK_EC_PROTO_STATS;
+	ret = devm_fwk_ec_stats_group_init(ec_dev->dev, &stats->proto);
+	if (ret)
+		return ret;
+
+	fwk_ec_stats_register(ec_dev, &stats->proto);
+
+	return 0;
+}
+EXPORT_SYMBOL(fwk_ec_stats_init);
+
+/**
+ * fwk_ec_stats_register() - Export the counters of a group.
+ * @ec_dev: EC device the counters are about.
+ * @group: Group initialized with devm_fwk_ec_stats_group_init().
+ */
+void fwk_ec_stats_register(struct fwk_ec_device *ec_dev,
+			   struct fwk_ec_stats_group *group)
+{
+	mutex_lock(&ec_dev->stats.lock);
+	list_add_tail(&group->node, &ec_dev->stats.groups);
+	mutex_unlock(&ec_dev->stats.lock);
+}
+EXPORT_SYMBOL(fwk_ec_stats_register);
+
+/**
+ * fwk_ec_stats_unregister() - Stop exporting the counters of a group.
+ * @ec_dev: EC device the group was registered with.
+ * @group: Group to remove.
+ */
+void fwk_ec_stats_unregister(struct fwk_ec_device *ec_dev,
+			     struct fwk_ec_stats_group *group)
+{
+	mutex_lock(&ec_dev->stats.lock);
+	list_del_init(&group->node);
+	mutex_unlock(&ec_dev->stats.lock);
+}
+EXPORT_SYMBOL(fwk_ec_stats_unregister);
+
+static u64 fwk_ec_stats_fold(struct fwk_ec_stats_group *group,
+			     unsigned int idx)
+{
+	u64 sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += per_cpu_ptr(group->counters, cpu)[idx];
+
+	return sum;
+}
+
+/**
+ * fwk_ec_stats_show() - Print the statistics in text format.
+ * @ec_dev: EC device.
+ * @s: Where to print.
+ *
+ * The first line is "version=<FWK_EC_STATS_VERSION>", followed by one
+ * "<group>.<counter>=<value>" line per counter.
+ *
+ * Return: 0.
+ */
+int fwk_ec_stats_show(struct fwk_ec_device *ec_dev, struct seq_file *s)
+{
+	struct fwk_ec_stats_group *group;
+	unsigned int i;
+
+	seq_printf(s, "version=%u\n", FWK_EC_STATS_VERSION);
+
+	mutex_lock(&ec_dev->stats.lock);
+	list_for_each_entry(group, &ec_dev->stats.groups, node) {
+		for (i = 0; i < group->count; i++) {
+			if (!group->names[i])
+				continue;
+			seq_printf(s, "%s.%s=%llu\n", group->name,
+				   group->names[i],
+				   fwk_ec_stats_fold(group, i));
+		}
+	}
+	mutex_unlock(&ec_dev->stats.lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(fwk_ec_stats_show);
+
+/**
+ * fwk_ec_stats_bin() - Snapshot the statistics in binary format.
+ * @ec_dev: EC device.
+ * @size: Set to the size of the snapshot.
+ *
+ * The snapshot is a struct fwk_ec_stats_bin_header followed by one struct
+ * fwk_ec_stats_bin_entry per counter.
+ *
+ * Return: the snapshot, to be freed with kvfree(), or NULL.
+ */
+void *fwk_ec_stats_bin(struct fwk_ec_device *ec_dev, size_t *size)
+{
+	struct fwk_ec_stats_bin_header *hdr;
+	struct fwk_ec_stats_bin_entry *entry;
+	struct fwk_ec_stats_group *group;
+	unsigned int i, count = 0;
+
+	mutex_lock(&ec_dev->stats.lock);
+	list_for_each_entry(group, &ec_dev->stats.groups, node) {
+		for (i = 0; i < group->count; i++)
+			count += !!group->names[i];
+	}
+
+	*size = sizeof(*hdr) + count * sizeof(*entry);
+	hdr = kvzalloc(*size, GFP_KERNEL);
+	if (!hdr)
+		goto out;
+
+	hdr->magic = cpu_to_le32(FWK_EC_STATS_MAGIC);
+	hdr->version = cpu_to_le16(FWK_EC_STATS_VERSION);
+	hdr->entry_size = cpu_to_le16(sizeof(*entry));
+	hdr->count = cpu_to_le32(count);
+
+	entry = (struct fwk_ec_stats_bin_entry *)(hdr + 1);
+	list_for_each_entry(group, &ec_dev->stats.groups, node) {
+		for (i = 0; i < group->count; i++) {
+			if (!group->names[i])
+				continue;
+			snprintf(entry->name, sizeof(entry->name), "%s.%s",
+				 group->name, group->names[i]);
+			entry->value = cpu_to_le64(fwk_ec_stats_fold(group, i));
+			entry++;
+		}
+	}
+out:
+	mutex_unlock(&ec_dev->stats.lock);
+
+	return hdr;
+}
+EXPORT_SYMBOL(fwk_ec_stats_bin);
@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Statistics of the ChromeOS Embedded Controller stack.
+ *
+ * Each driver registers a group of per-CPU counters with the device it
+ * drives. Counters are bumped with a single this_cpu operation and only
+ * summed over all CPUs when the statistics are read.
+ */
+
+#ifndef __LINUX_FWK_EC_STATS_H
+#define __LINUX_FWK_EC_STATS_H
+
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/types.h>
+
+#include <fwk_ec_commands.h>
+
+struct device;
+struct fwk_ec_device;
+struct seq_file;
+
+/*
+ * Version of the export formats. Counters may be added without a version
+ * change, so readers must look them up by name. The version is bumped when
+ * the meaning of an existing counter or the layout below changes.
+ */
+#define FWK_EC_STATS_VERSION	1
+
+/* "FECS", little endian. */
+#define FWK_EC_STATS_MAGIC	0x53434546
+
+#define FWK_EC_STATS_NAME_LEN	48
+
+/**
+ * struct fwk_ec_stats_bin_header - Header of the binary statistics export.
+ * @magic: FWK_EC_STATS_MAGIC.
+ * @version: FWK_EC_STATS_VERSION.
+ * @entry_size: Size of the entries, sizeof(struct fwk_ec_stats_bin_entry).
+ * @count: Number of entries following the header.
+ * @reserved: Zero.
+ *
+ * All fields are little endian.
+ */
+struct fwk_ec_stats_bin_header {
+	__le32 magic;
+	__le16 version;
+	__le16 entry_size;
+	__le32 count;
+	__le32 reserved;
+};
+
+/**
+ * struct fwk_ec_stats_bin_entry - Counter of the binary statistics export.
+ * @name: "<group>.<counter>", NUL padded. The text export uses the same
+ *        names.
+ * @value: Value of the counter.
+ */
+struct fwk_ec_stats_bin_entry {
+	char name[FWK_EC_STATS_NAME_LEN];
+	__le64 value;
+};
+
+/**
+ * struct fwk_ec_stats_group - Set of counters of a driver.
+ * @name: Prefix of the counter names.
+ * @names: Name of each counter. NULL entries are not exported.
+ * @count: Number of counters.
+ * @counters: The per-CPU counters, see devm_fwk_ec_stats_group_init().
+ * @node: Links into the groups list of the struct fwk_ec_stats.
+ */
+struct fwk_ec_stats_group {
+	const char *name;
+	const char * const *names;
+	unsigned int count;
+	u64 __percpu *counters;
+	struct list_head node;
+};
+
+/* Results above EC_RES_DUP_UNAVAILABLE are accounted together. */
+#define FWK_EC_STAT_RESULTS	(EC_RES_DUP_UNAVAILABLE + 2)
+
+/**
+ * enum fwk_ec_proto_stat - Counters of the protocol layer.
+ * @FWK_EC_STAT_COMMANDS: Transfers on the transport, including the ones
+ *                        issued by the protocol layer itself.
+ * @FWK_EC_STAT_BYTES_OUT: Request payload bytes.
+ * @FWK_EC_STAT_BYTES_IN: Response payload bytes.
+ * @FWK_EC_STAT_XFER_ERRORS: Transfers which failed on the transport.
+ * @FWK_EC_STAT_TIMEOUTS: Transfers which timed out, and commands still in
+ *                        progress after EC_COMMAND_RETRIES status polls.
+ * @FWK_EC_STAT_RETRIES: Status polls of commands in progress, and commands
+ *                       sent again after a timeout.
+ * @FWK_EC_STAT_LOCK_WAITS: Commands which had to wait for the bus.
+ * @FWK_EC_STAT_EVENTS: Events fetched from the EC.
+ * @FWK_EC_STAT_RESULT: First of the FWK_EC_STAT_RESULTS counters of
+ *                      EC_RES_* results.
+ * @FWK_EC_STAT_EVENT_TYPE: First of the EC_MKBP_EVENT_COUNT counters of
+ *                          events, by type.
+ * @FWK_EC_PROTO_STATS: Number of counters.
+ */
+enum fwk_ec_proto_stat {
+	FWK_EC_STAT_COMMANDS,
+	FWK_EC_STAT_BYTES_OUT,
+	FWK_EC_STAT_BYTES_IN,
+	FWK_EC_STAT_XFER_ERRORS,
+	FWK_EC_STAT_TIMEOUTS,
+	FWK_EC_STAT_RETRIES,
+	FWK_EC_STAT_LOCK_WAITS,
+	FWK_EC_STAT_EVENTS,
+	FWK_EC_STAT_RESULT,
+	FWK_EC_STAT_EVENT_TYPE = FWK_EC_STAT_RESULT + FWK_EC_STAT_RESULTS,
+	FWK_EC_PROTO_STATS = FWK_EC_STAT_EVENT_TYPE + EC_MKBP_EVENT_COUNT,
+};
+
+/**
+ * struct fwk_ec_stats - Statistics registry of an EC device.
+ * @lock: Protects @groups.
+ * @groups: Registered struct fwk_ec_stats_group.
+ * @proto: Counters of the protocol layer, see enum fwk_ec_proto_stat.
+ * @core: Counters of the core driver.
+ */
+struct fwk_ec_stats {
+	struct mutex lock;
+	struct list_head groups;
+	struct fwk_ec_stats_group proto;
+	struct fwk_ec_stats_group core;
+};
+
+/**
+ * fwk_ec_stat_add() - Add to a counter.
+ * @group: Group of the counter.
+ * @idx: Index of the counter in the group.
+ * @val: Value to add.
+ *
+ * Safe from any context, the counter is per-CPU.
+ */
+static inline void fwk_ec_stat_add(struct fwk_ec_stats_group *group,
+				   unsigned int idx, u64 val)
+{
+	this_cpu_add(group->counters[idx], val);
+}
+
+static inline void fwk_ec_stat_inc(struct fwk_ec_stats_group *group,
+				   unsigned int idx)
+{
+	this_cpu_inc(group->counters[idx]);
+}
+
+int devm_fwk_ec_stats_group_init(struct device *dev,
+				 struct fwk_ec_stats_group *group);
+
+int fwk_ec_stats_init(struct fwk_ec_device *ec_dev);
+
+void fwk_ec_stats_register(struct fwk_ec_device *ec_dev,
+			   struct fwk_ec_stats_group *group);
+
+void fwk_ec_stats_unregister(struct fwk_ec_device *ec_dev,
+			     struct fwk_ec_stats_group *group);
+
+int fwk_ec_stats_show(struct fwk_ec_device *ec_dev, struct seq_file *s);
+
+void *fwk_ec_stats_bin(struct fwk_ec_device *ec_dev, size_t *size);
+
+#endif /* __LINUX_FWK_EC_STATS_H */